@@ -0,0 +1,74 @@
+#include <atomic>
+#include <thread>
+#include "Analysis.h"
+#include "Enumerator/Enumerator.h"
+
+namespace Sudoku
+{
+    namespace
+    {
+        template <typename Function>
+        void parallelFor(size_t num, unsigned int threads, Function function)
+        {
+            std::atomic<size_t> next(0);
+            auto work = [&]()
+            {
+                for(size_t i=next++; i<num; i=next++)
+                    function(i);
+            };
+            std::vector<std::thread> workers;
+            for(unsigned int i=1; i<threads && i<num; ++i)
+                workers.push_back(std::thread(work));
+            work();
+            for(auto& worker: workers)
+                worker.join();
+        }
+    }
+
+    std::vector<Minimality> analyzeMinimality(const std::vector<Grid>& puzzles, unsigned int threads)
+    {
+        std::vector<Minimality> results(puzzles.size());
+        parallelFor(puzzles.size(), threads, [&](size_t i)
+        {
+            Minimality& result = results[i];
+            for(int cell=0; cell<CELLS; ++cell)
+            {
+                if(puzzles[i][cell] != 0)
+                    result.clues.push_back(cell);
+            }
+            try
+            {
+                result.solutions = countSolutions(puzzles[i].data(), 2);
+            }
+            catch(const std::exception&)
+            {
+                result.solutions = 0;
+            }
+        });
+
+        // one job per clue of each unique puzzle
+        std::vector<std::pair<size_t, int>> jobs;
+        for(size_t i=0; i<puzzles.size(); ++i)
+        {
+            if(results[i].solutions != 1)
+                continue;
+            for(auto cell: results[i].clues)
+                jobs.push_back(std::make_pair(i, cell));
+        }
+        std::vector<char> redundant(jobs.size(), 0);
+        parallelFor(jobs.size(), threads, [&](size_t j)
+        {
+            Grid grid = puzzles[jobs[j].first];
+            int cell = jobs[j].second;
+            int value = grid[cell];
+            grid[cell] = 0;
+            redundant[j] = !hasSolutionWithout(grid.data(), cell, value);
+        });
+        for(size_t j=0; j<jobs.size(); ++j)
+        {
+            if(redundant[j])
+                results[jobs[j].first].redundant.push_back(jobs[j].second);
+        }
+        return results;
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef _ANALYSIS_H
+#define _ANALYSIS_H
+
+#include <array>
+#include <vector>
+#include "Sudoku/Sudoku.h"
+
+namespace Sudoku
+{
+    struct Minimality
+    {
+        unsigned int solutions;         // 0, 1 or 2 for two and more
+        std::vector<int> clues;         // cells (row * 9 + column) holding a given
+        std::vector<int> redundant;     // givens whose removal keeps the solution unique
+        bool minimal(void) const {return solutions == 1 && redundant.empty();}
+    };
+
+    /*
+     * For every given of every unique puzzle, checks whether the puzzle stays
+     * unique without it. The puzzle's own solution always survives a removal,
+     * so a clue is redundant exactly when no solution puts another digit in
+     * its cell; that single search replaces a full count per clue.
+     * Clue tests of all puzzles are spread over the threads together.
+     */
+    std::vector<Minimality> analyzeMinimality(const std::vector<Grid>& puzzles, unsigned int threads=1);
+};
+#endif
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Solver/Solver.h"
+#include "Sudoku/Sudoku.h"
+#include "Perf/Perf.h"
+
+/*
+ * Microbenchmarks of the solver building blocks. Each primitive runs in
+ * batches on fixed board states: batches grow until one takes MIN_BATCH_US
+ * (which doubles as warmup), then SAMPLES batches are timed and summarized.
+ * Primitives that modify the board get a fresh copy per operation, prepared
+ * outside the timed region.
+ */
+using namespace Sudoku;
+
+namespace
+{
+    const double MIN_BATCH_US = 1000;
+    const size_t MAX_COPIES = 256;
+    volatile size_t g_sink;
+
+    struct Result
+    {
+        std::string name;
+        std::string state;
+        size_t batch;
+        double min_ns;
+        double median_ns;
+        double p90_ns;
+        PerfSample perf;    // per operation
+    };
+
+    struct State
+    {
+        std::string name;
+        Solver solver;
+        Coord open;     // an empty cell with at least two candidates
+        int value;      // its first candidate
+    };
+
+    class Bench
+    {
+    public:
+        Bench(unsigned int samples, const char* filter, bool perf):
+            m_samples(samples),
+            m_filter(filter),
+            m_perf(perf)
+        {}
+
+        // prepare(n) runs untimed before every batch of n calls to op(i)
+        void run(const std::string& name, const State& state, size_t max_batch,
+            std::function<void(size_t)> prepare, std::function<void(size_t)> op)
+        {
+            if(m_filter != nullptr && name.find(m_filter) == std::string::npos)
+                return;
+            size_t batch = 1;
+            while(true)
+            {
+                double elapsed = time(batch, prepare, op, nullptr);
+                if(elapsed >= MIN_BATCH_US || batch >= max_batch)
+                    break;
+                batch = std::min(max_batch, batch * 2);
+            }
+            std::vector<double> samples;
+            PerfSample perf;
+            for(unsigned int i=0; i<m_samples; ++i)
+                samples.push_back(time(batch, prepare, op, &perf) * 1000 / batch);
+            std::sort(samples.begin(), samples.end());
+            Result result;
+            result.name = name;
+            result.state = state.name;
+            result.batch = batch;
+            result.min_ns = samples.front();
+            result.median_ns = samples[samples.size() / 2];
+            result.p90_ns = samples[std::min(samples.size() - 1, samples.size() * 9 / 10)];
+            for(int i=0; i<COUNTER_NUM; ++i)
+            {
+                result.perf.valid[i] = perf.valid[i];
+                result.perf.values[i] = perf.values[i] / (batch * m_samples);
+            }
+            std::printf("%-28s %-10s %8zu %12.1f %12.1f %12.1f\n", name.c_str(), state.name.c_str(),
+                batch, result.min_ns, result.median_ns, result.p90_ns);
+            m_results.push_back(result);
+        }
+
+        const std::vector<Result>& getResults(void) {return m_results;}
+    private:
+        double time(size_t batch, std::function<void(size_t)>& prepare, std::function<void(size_t)>& op,
+            PerfSample* perf)
+        {
+            prepare(batch);
+            PerfSample before;
+            if(m_perf && perf != nullptr)
+                before = PerfCounters::thread().read();
+            auto tic = std::chrono::steady_clock::now();
+            for(size_t i=0; i<batch; ++i)
+                op(i);
+            double elapsed = getTimeDiff(tic);
+            if(m_perf && perf != nullptr)
+                perf->add(PerfCounters::thread().read() - before);
+            return elapsed;
+        }
+
+        unsigned int m_samples;
+        const char* m_filter;
+        bool m_perf;
+        std::vector<Result> m_results;
+    };
+
+    State makeState(const std::string& name, const char* puzzle, unsigned int iters)
+    {
+        uint8_t grid[CELLS];
+        parseGrid(puzzle, std::strlen(puzzle), grid);
+        State state{name, Solver(grid), Coord(0, 0), 0};
+        if(iters != 0)
+        {
+            Options options;
+            options.max_iters = iters;
+            state.solver.solve(options);
+        }
+        for(auto& pair: state.solver.getAux())
+        {
+            if(pair.second.size() >= 2)
+            {
+                state.open = pair.first;
+                state.value = pair.second[0];
+                break;
+            }
+        }
+        return state;
+    }
+
+    void writeJson(const char* filename, const std::vector<Result>& results)
+    {
+        std::ofstream f(filename);
+        f << "[\n";
+        for(size_t i=0; i<results.size(); ++i)
+        {
+            const Result& result = results[i];
+            f << "  {\"name\": \"" << result.name << "\", \"state\": \"" << result.state
+                << "\", \"batch\": " << result.batch << ", \"min_ns\": " << result.min_ns
+                << ", \"median_ns\": " << result.median_ns << ", \"p90_ns\": " << result.p90_ns
+                << ", \"perf_per_op\": ";
+            writePerfJson(f, result.perf);
+            f << "}" << (i + 1 < results.size()? ",": "") << "\n";
+        }
+        f << "]\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int samples = 15;
+    const char* filter = nullptr;
+    const char* json_file = nullptr;
+    bool perf = false;
+    for(int i=1; i<argc; ++i)
+    {
+        if(std::strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            samples = std::max(1, std::atoi(argv[++i]));
+        else if(std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if(std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            json_file = argv[++i];
+        else if(std::strcmp(argv[i], "--perf") == 0)
+            perf = true;
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [--samples N] [--filter NAME] [--json F] [--perf]\n", argv[0]);
+            return -1;
+        }
+    }
+    if(perf && !PerfCounters::thread().available())
+        std::fprintf(stderr, "Hardware counters unavailable, timing only\n");
+
+    // a 30-clue easy grid, a 21-clue hard one before and in the middle of its search
+    std::vector<State> states;
+    states.push_back(makeState("easy", "530070000600195000098000060800060003400803001700020006060000280000419005000080079", 0));
+    states.push_back(makeState("hard", "800000000003600000070090200050007000000045700000100030001000068008500010090000400", 0));
+    states.push_back(makeState("hard-mid", "800000000003600000070090200050007000000045700000100030001000068008500010090000400", 12));
+
+    Bench bench(samples, filter, perf);
+    std::printf("%-28s %-10s %8s %12s %12s %12s\n", "primitive", "state", "batch", "min ns", "median ns", "p90 ns");
+    auto nothing = [](size_t) {};
+    std::vector<Solver> copies;
+    std::vector<Node> nodes;
+    for(auto& state: states)
+    {
+        Solver& solver = state.solver;
+        Coord open = state.open;
+        int value = state.value;
+        std::vector<int> values = solver.getAux().at(open);
+        bench.run("Solver::generateAux", state, SIZE_MAX, nothing,
+            [&](size_t) {solver.generateAux(open);});
+        bench.run("Solver::removeAux", state, MAX_COPIES,
+            [&](size_t n) {copies.assign(n, solver);},
+            [&](size_t i)
+            {
+                try
+                {
+                    copies[i].removeAux(open, {value}, {open});
+                }
+                catch(const std::exception&)
+                {
+                }
+            });
+        bench.run("countSameBlockAuxFreqMap", state, SIZE_MAX, nothing,
+            [&](size_t i) {g_sink += solver.countSameBlockAuxFreqMap(i % SIZE).size();});
+        bench.run("Problem::setCell+clear", state, MAX_COPIES,
+            [&](size_t n) {copies.assign(n, solver);},
+            [&](size_t i)
+            {
+                Problem& problem = copies[i];
+                problem.setCell(open, value);
+                problem.setCell(open, 0);
+            });
+        bench.run("Problem::getBlockCoords(block)", state, SIZE_MAX, nothing,
+            [&](size_t i) {g_sink += solver.getBlockCoords(static_cast<unsigned int>(i % SIZE)).size();});
+        bench.run("Problem::getBlockCoords(coord)", state, SIZE_MAX, nothing,
+            [&](size_t i) {g_sink += solver.getBlockCoords(Coord(i % SIZE, (i / SIZE) % SIZE)).size();});
+        bench.run("valueInside(vector)", state, SIZE_MAX, nothing,
+            [&](size_t i) {g_sink += valueInside(values, i % SIZE + 1);});
+        bench.run("Solver::isRecordedCell", state, SIZE_MAX, nothing,
+            [&](size_t i) {g_sink += solver.isRecordedCell(Coord(i % SIZE, (i / SIZE) % SIZE));});
+        bench.run("Node copy", state, MAX_COPIES,
+            [&](size_t n) {nodes.clear(); nodes.reserve(n);},
+            [&](size_t) {nodes.push_back(Node(open, solver.getAux(), std::vector<std::pair<Coord, Coord>>()));});
+        if(solver.getGuessNum() > 0)
+        {
+            bench.run("Solver::backtrace", state, MAX_COPIES,
+                [&](size_t n) {copies.assign(n, solver);},
+                [&](size_t i) {g_sink += copies[i].backtrace();});
+        }
+    }
+    if(json_file != nullptr)
+        writeJson(json_file, bench.getResults());
+    return 0;
+}
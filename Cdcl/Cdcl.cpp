@@ -0,0 +1,458 @@
+#include <algorithm>
+#include "Cdcl.h"
+#include "Trace/Trace.h"
+
+#define VARS (CELLS * SIZE)
+
+namespace Sudoku
+{
+    namespace
+    {
+        // positive literal of "cell holds value", the negation is literal ^ 1
+        int literal(int cell, int value)
+        {
+            return 2 * (cell * SIZE + value - 1);
+        }
+
+        // 1, 1, 2, 1, 1, 2, 4, 1, 1, 2, ...
+        double luby(unsigned long i)
+        {
+            unsigned long size = 1, seq = 0;
+            while(size < i + 1)
+            {
+                ++seq;
+                size = 2 * size + 1;
+            }
+            while(size - 1 != i)
+            {
+                size = (size - 1) >> 1;
+                --seq;
+                i = i % size;
+            }
+            return static_cast<double>(1UL << seq);
+        }
+    }
+
+    CdclSolver::CdclSolver(const uint8_t grid[CELLS]):
+        m_watches(2 * VARS),
+        m_assigns(VARS, -1),
+        m_level(VARS, 0),
+        m_reason(VARS, -1),
+        m_queue_head(0),
+        m_activity(VARS, 0),
+        m_var_inc(1),
+        m_clause_inc(1),
+        m_phase(VARS, 1),
+        m_seen(VARS, 0),
+        m_max_learned(2000),
+        m_inconsistent(false),
+        m_conflict_num(0),
+        m_decision_num(0),
+        m_given_num(0),
+        m_backjump_num(0),
+        m_learned_num(0),
+        m_restart_num(0)
+    {
+        // the givens fix their own variables and rule out the peers' ones at level 0,
+        // clauses are only generated over the variables still open
+        uint16_t row_mask[SIZE] = {0}, column_mask[SIZE] = {0}, block_mask[SIZE] = {0};
+        for(int cell=0; cell<CELLS; ++cell)
+        {
+            if(grid[cell] > SIZE)
+                throw std::runtime_error("Invalid value " + std::to_string(grid[cell]));
+            if(grid[cell] == 0)
+                continue;
+            ++m_given_num;
+            int row = cell / SIZE, column = cell % SIZE, block_id = (row / 3) * 3 + column / 3;
+            uint16_t bit = 1 << grid[cell];
+            if((row_mask[row] | column_mask[column] | block_mask[block_id]) & bit)
+                m_inconsistent = true;
+            row_mask[row] |= bit;
+            column_mask[column] |= bit;
+            block_mask[block_id] |= bit;
+        }
+        uint16_t open[CELLS];
+        for(int cell=0; cell<CELLS; ++cell)
+        {
+            int row = cell / SIZE, column = cell % SIZE, block_id = (row / 3) * 3 + column / 3;
+            open[cell] = grid[cell] != 0? 0:
+                FULL_MASK & ~(row_mask[row] | column_mask[column] | block_mask[block_id]);
+            for(int value=1; value<=SIZE; ++value)
+            {
+                if(!(open[cell] & (1 << value)))
+                    m_assigns[cell * SIZE + value - 1] = grid[cell] == value? 1: 0;
+            }
+        }
+        m_literals.reserve(32 * 1024);
+        m_clauses.reserve(16 * 1024);
+        int lits[SIZE];
+        // every open cell holds exactly one of its candidates
+        for(int cell=0; cell<CELLS; ++cell)
+        {
+            if(grid[cell] != 0)
+                continue;
+            int size = 0;
+            for(int value=1; value<=SIZE; ++value)
+            {
+                if(open[cell] & (1 << value))
+                    lits[size++] = literal(cell, value);
+            }
+            addExactlyOne(lits, size);
+        }
+        // every row, column and block holds each missing value exactly once
+        const auto& units = Regions().getUnits();
+        for(int unit=0; unit<3 * SIZE; ++unit)
+        {
+            const std::array<uint8_t, SIZE>& cells = units[unit];
+            uint16_t placed;
+            if(unit < SIZE)
+                placed = row_mask[unit];
+            else if(unit < 2 * SIZE)
+                placed = column_mask[unit - SIZE];
+            else
+                placed = block_mask[unit - 2 * SIZE];
+            for(int value=1; value<=SIZE; ++value)
+            {
+                if(placed & (1 << value))
+                    continue;
+                int size = 0;
+                for(int i=0; i<SIZE; ++i)
+                {
+                    if(open[cells[i]] & (1 << value))
+                        lits[size++] = literal(cells[i], value);
+                }
+                addExactlyOne(lits, size);
+            }
+        }
+    }
+
+    void CdclSolver::addExactlyOne(const int* lits, int size)
+    {
+        if(size == 0)
+        {
+            m_inconsistent = true;
+            return;
+        }
+        if(size == 1)
+        {
+            if(value(lits[0]) == 0)
+                m_inconsistent = true;
+            else if(value(lits[0]) < 0)
+                enqueue(lits[0], -1);
+            return;
+        }
+        addClause(lits, size, false);
+        for(int a=0; a<size; ++a)
+        {
+            for(int b=a+1; b<size; ++b)
+            {
+                int pair[2] = {lits[a] ^ 1, lits[b] ^ 1};
+                addClause(pair, 2, false);
+            }
+        }
+    }
+
+    void CdclSolver::addClause(const int* lits, int size, bool learnt)
+    {
+        Clause clause;
+        clause.start = m_literals.size();
+        clause.size = size;
+        clause.learnt = learnt;
+        clause.deleted = false;
+        clause.activity = 0;
+        m_literals.insert(m_literals.end(), lits, lits + size);
+        m_watches[lits[0]].push_back(m_clauses.size());
+        m_watches[lits[1]].push_back(m_clauses.size());
+        m_clauses.push_back(clause);
+    }
+
+    void CdclSolver::enqueue(int lit, int reason)
+    {
+        int var = lit >> 1;
+        m_assigns[var] = (lit & 1)? 0: 1;
+        m_level[var] = decisionLevel();
+        m_reason[var] = reason;
+        m_trail.push_back(lit);
+        // a decision is a guess, anything else follows from a clause
+        TraceRule rule = reason < 0? TraceRule::Guess: TraceRule::Clause;
+        TraceType type = (lit & 1)? TraceType::Eliminate: (reason < 0? TraceType::Guess: TraceType::Set);
+        traceEvent(type, var / SIZE, var % SIZE + 1, rule, m_conflict_num);
+    }
+
+    int CdclSolver::propagate(void)
+    {
+        while(m_queue_head < m_trail.size())
+        {
+            int falsified = m_trail[m_queue_head++] ^ 1;
+            std::vector<int>& watches = m_watches[falsified];
+            size_t i = 0, j = 0;
+            while(i < watches.size())
+            {
+                int clause_id = watches[i++];
+                Clause& clause = m_clauses[clause_id];
+                if(clause.deleted)
+                    continue;
+                int* lits = &m_literals[clause.start];
+                if(lits[0] == falsified)
+                    std::swap(lits[0], lits[1]);
+                if(value(lits[0]) == 1)
+                {
+                    watches[j++] = clause_id;
+                    continue;
+                }
+                bool moved = false;
+                for(unsigned int k=2; k<clause.size; ++k)
+                {
+                    if(value(lits[k]) != 0)
+                    {
+                        std::swap(lits[1], lits[k]);
+                        m_watches[lits[1]].push_back(clause_id);
+                        moved = true;
+                        break;
+                    }
+                }
+                if(moved)
+                    continue;
+                watches[j++] = clause_id;
+                if(value(lits[0]) == 0)
+                {
+                    while(i < watches.size())
+                        watches[j++] = watches[i++];
+                    watches.resize(j);
+                    m_queue_head = m_trail.size();
+                    return clause_id;
+                }
+                enqueue(lits[0], clause_id);
+            }
+            watches.resize(j);
+        }
+        return -1;
+    }
+
+    int CdclSolver::analyze(int conflict, std::vector<int>& learnt)
+    {
+        learnt.assign(1, -1);
+        int path_num = 0, lit = -1;
+        int index = m_trail.size() - 1;
+        do
+        {
+            Clause& clause = m_clauses[conflict];
+            if(clause.learnt)
+                bumpClause(clause);
+            const int* lits = &m_literals[clause.start];
+            // the implied literal of a reason clause sits at lits[0]
+            for(unsigned int k=(lit < 0? 0: 1); k<clause.size; ++k)
+            {
+                int var = lits[k] >> 1;
+                if(m_seen[var] || m_level[var] == 0)
+                    continue;
+                m_seen[var] = 1;
+                bumpVariable(var);
+                if(m_level[var] >= decisionLevel())
+                    ++path_num;
+                else
+                    learnt.push_back(lits[k]);
+            }
+            while(!m_seen[m_trail[index] >> 1])
+                --index;
+            lit = m_trail[index--];
+            conflict = m_reason[lit >> 1];
+            m_seen[lit >> 1] = 0;
+            --path_num;
+        } while(path_num > 0);
+        learnt[0] = lit ^ 1;
+
+        int level = 0;
+        for(size_t k=1; k<learnt.size(); ++k)
+        {
+            m_seen[learnt[k] >> 1] = 0;
+            if(m_level[learnt[k] >> 1] > level)
+            {
+                level = m_level[learnt[k] >> 1];
+                std::swap(learnt[1], learnt[k]);
+            }
+        }
+        return level;
+    }
+
+    void CdclSolver::backjump(int level)
+    {
+        if(decisionLevel() <= level)
+            return;
+        traceEvent(TraceType::Backtrace, 255, std::min(decisionLevel() - level, 255), TraceRule::None, m_conflict_num);
+        for(int k=m_trail.size() - 1; k>=m_trail_lim[level]; --k)
+        {
+            int var = m_trail[k] >> 1;
+            m_phase[var] = m_assigns[var];
+            m_assigns[var] = -1;
+            m_reason[var] = -1;
+        }
+        m_trail.resize(m_trail_lim[level]);
+        m_trail_lim.resize(level);
+        m_queue_head = m_trail.size();
+    }
+
+    int CdclSolver::pickBranchLiteral(void)
+    {
+        int best = -1;
+        for(int var=0; var<VARS; ++var)
+        {
+            if(m_assigns[var] < 0 && (best < 0 || m_activity[var] > m_activity[best]))
+                best = var;
+        }
+        if(best < 0)
+            return -1;
+        return 2 * best + (m_phase[best]? 0: 1);
+    }
+
+    void CdclSolver::bumpVariable(int var)
+    {
+        m_activity[var] += m_var_inc;
+        if(m_activity[var] > 1e100)
+        {
+            for(auto& activity: m_activity)
+                activity *= 1e-100;
+            m_var_inc *= 1e-100;
+        }
+    }
+
+    void CdclSolver::bumpClause(Clause& clause)
+    {
+        clause.activity += m_clause_inc;
+        if(clause.activity > 1e20)
+        {
+            for(auto& _clause: m_clauses)
+            {
+                if(_clause.learnt)
+                    _clause.activity *= 1e-20;
+            }
+            m_clause_inc *= 1e-20;
+        }
+    }
+
+    void CdclSolver::reduceLearned(void)
+    {
+        std::vector<int> candidates;
+        for(size_t i=0; i<m_clauses.size(); ++i)
+        {
+            const Clause& clause = m_clauses[i];
+            if(!clause.learnt || clause.deleted || clause.size <= 2)
+                continue;
+            int first = m_literals[clause.start];
+            // clauses still implying an assignment stay
+            if(value(first) == 1 && m_reason[first >> 1] == static_cast<int>(i))
+                continue;
+            candidates.push_back(i);
+        }
+        std::sort(candidates.begin(), candidates.end(), [this](int a, int b)
+            {return m_clauses[a].activity < m_clauses[b].activity;});
+        for(size_t i=0; i<candidates.size() / 2; ++i)
+            m_clauses[candidates[i]].deleted = true;
+    }
+
+    bool CdclSolver::interrupted(const Options& options)
+    {
+        if(options.cancel != nullptr && options.cancel->load(std::memory_order_relaxed))
+            return true;
+        return options.time_limit_us > 0 && std::chrono::steady_clock::now() >= m_deadline;
+    }
+
+    Status CdclSolver::solve(const Options& options)
+    {
+        traceEvent(TraceType::Begin, 255, m_given_num, TraceRule::None, 0);
+        if(m_inconsistent || propagate() >= 0)
+            return Status::Unsolvable;
+        if(options.time_limit_us > 0)
+        {
+            m_deadline = std::chrono::steady_clock::now() +
+                std::chrono::microseconds(options.time_limit_us);
+        }
+        std::vector<int> learnt;
+        unsigned long restart_limit = 64 * luby(0), restart_conflicts = 0;
+        size_t learned_live = 0;
+        unsigned long steps = 0;
+        while(true)
+        {
+            if((++steps & 0xFF) == 0 && interrupted(options))
+            {
+                backjump(0);
+                if(options.cancel != nullptr && options.cancel->load(std::memory_order_relaxed))
+                    return Status::Cancelled;
+                return Status::TimedOut;
+            }
+            int conflict = propagate();
+            if(conflict >= 0)
+            {
+                traceEvent(TraceType::Contradiction, 255, 0, TraceRule::Clause, m_conflict_num);
+                ++m_conflict_num;
+                ++restart_conflicts;
+                if(decisionLevel() == 0)
+                    return Status::Unsolvable;
+                int level = analyze(conflict, learnt);
+                ++m_backjump_num;
+                backjump(level);
+                if(learnt.size() == 1)
+                    enqueue(learnt[0], -1);
+                else
+                {
+                    addClause(learnt.data(), learnt.size(), true);
+                    ++m_learned_num;
+                    ++learned_live;
+                    bumpClause(m_clauses.back());
+                    enqueue(learnt[0], m_clauses.size() - 1);
+                }
+                m_var_inc /= 0.95;
+                m_clause_inc /= 0.999;
+                if(options.max_iters != 0 && m_conflict_num >= options.max_iters)
+                {
+                    backjump(0);
+                    return Status::IterLimit;
+                }
+                continue;
+            }
+            if(restart_conflicts >= restart_limit)
+            {
+                ++m_restart_num;
+                restart_conflicts = 0;
+                restart_limit = 64 * luby(m_restart_num);
+                backjump(0);
+            }
+            if(learned_live >= m_max_learned)
+            {
+                reduceLearned();
+                learned_live /= 2;
+                m_max_learned += m_max_learned / 10;
+            }
+            int lit = pickBranchLiteral();
+            if(lit < 0)
+                return Status::Solved;
+            ++m_decision_num;
+            m_trail_lim.push_back(m_trail.size());
+            enqueue(lit, -1);
+        }
+    }
+
+    void CdclSolver::getGrid(uint8_t out[CELLS])
+    {
+        for(int cell=0; cell<CELLS; ++cell)
+        {
+            out[cell] = 0;
+            for(int value=1; value<=SIZE; ++value)
+            {
+                if(m_assigns[cell * SIZE + value - 1] == 1)
+                    out[cell] = value;
+            }
+        }
+    }
+
+    uint16_t CdclSolver::getCandidateMask(int cell)
+    {
+        uint16_t mask = 0;
+        for(int value=1; value<=SIZE; ++value)
+        {
+            if(m_assigns[cell * SIZE + value - 1] != 0)
+                mask |= 1 << value;
+        }
+        return mask;
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef _CDCL_H
+#define _CDCL_H
+
+#include <vector>
+#include <chrono>
+#include "Sudoku/Sudoku.h"
+
+namespace Sudoku
+{
+    /*
+     * Conflict-driven clause learning over the CNF encoding of the grid:
+     * variable cell * 9 + (value - 1) is true when the cell holds value.
+     * Two watched literals, first-UIP learning with non-chronological
+     * backjumping, VSIDS branching with phase saving and Luby restarts.
+     */
+    class CdclSolver
+    {
+    public:
+        CdclSolver(const uint8_t grid[CELLS]);
+        Status solve(const Options& options=Options());
+        // solved cells, or the cells fixed at decision level 0 if the search stopped early
+        void getGrid(uint8_t out[CELLS]);
+        uint16_t getCandidateMask(int cell);
+        unsigned long getConflictNum(void) {return m_conflict_num;}
+        unsigned long getDecisionNum(void) {return m_decision_num;}
+        unsigned long getBackjumpNum(void) {return m_backjump_num;}
+        unsigned long getLearnedNum(void) {return m_learned_num;}
+        unsigned long getRestartNum(void) {return m_restart_num;}
+    private:
+        struct Clause
+        {
+            unsigned int start;   // offset in m_literals
+            unsigned int size;
+            bool learnt;
+            bool deleted;
+            double activity;
+        };
+        int value(int lit) {return m_assigns[lit >> 1] < 0? -1: m_assigns[lit >> 1] ^ (lit & 1);}
+        int decisionLevel(void) {return m_trail_lim.size();}
+        void addClause(const int* lits, int size, bool learnt);
+        void addExactlyOne(const int* lits, int size);
+        void enqueue(int lit, int reason);
+        int propagate(void);
+        int analyze(int conflict, std::vector<int>& learnt);
+        void backjump(int level);
+        int pickBranchLiteral(void);
+        void bumpVariable(int var);
+        void bumpClause(Clause& clause);
+        void reduceLearned(void);
+        bool interrupted(const Options& options);
+        std::vector<int> m_literals;
+        std::vector<Clause> m_clauses;
+        std::vector<std::vector<int>> m_watches;  // clauses to visit when the literal becomes false
+        std::vector<int> m_assigns;               // -1 unassigned, 0 false, 1 true
+        std::vector<int> m_level;
+        std::vector<int> m_reason;                // implying clause, -1 for decisions and givens
+        std::vector<int> m_trail;
+        std::vector<int> m_trail_lim;
+        size_t m_queue_head;
+        std::vector<double> m_activity;
+        double m_var_inc;
+        double m_clause_inc;
+        std::vector<char> m_phase;
+        std::vector<char> m_seen;
+        size_t m_max_learned;
+        bool m_inconsistent;
+        unsigned long m_conflict_num;
+        unsigned long m_decision_num;
+        int m_given_num;
+        unsigned long m_backjump_num;
+        unsigned long m_learned_num;
+        unsigned long m_restart_num;
+        std::chrono::steady_clock::time_point m_deadline;
+    };
+};
+#endif
@@ -0,0 +1,526 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include "Enumerator.h"
+
+namespace Sudoku
+{
+    namespace
+    {
+        const int NO_REASON = -1;
+
+        const std::array<uint8_t, CELLS>& blockIds(void)
+        {
+            static const std::array<uint8_t, CELLS> ids = []()
+            {
+                std::array<uint8_t, CELLS> ids;
+                for(int cell=0; cell<CELLS; ++cell)
+                    ids[cell] = computeBlockId(Coord(cell / SIZE, cell % SIZE));
+                return ids;
+            }();
+            return ids;
+        }
+
+        struct Board
+        {
+            uint8_t cells[CELLS];
+            uint16_t row[SIZE];
+            uint16_t column[SIZE];
+            uint16_t block[SIZE];
+
+            uint16_t candidates(int cell, const uint8_t* block_ids) const
+            {
+                return FULL_MASK & ~(row[cell / SIZE] | column[cell % SIZE] | block[block_ids[cell]]);
+            }
+
+            void place(int cell, int value, const uint8_t* block_ids)
+            {
+                uint16_t bit = 1 << value;
+                cells[cell] = value;
+                row[cell / SIZE] |= bit;
+                column[cell % SIZE] |= bit;
+                block[block_ids[cell]] |= bit;
+            }
+
+            void unplace(int cell, int value, const uint8_t* block_ids)
+            {
+                uint16_t bit = ~(1 << value);
+                cells[cell] = 0;
+                row[cell / SIZE] &= bit;
+                column[cell % SIZE] &= bit;
+                block[block_ids[cell]] &= bit;
+            }
+
+            // open cell with the fewest candidates, CELLS if solved, -1 on a dead end
+            int pick(uint16_t& mask, const uint8_t* block_ids) const
+            {
+                int best = CELLS;
+                unsigned int fewest = SIZE + 1;
+                for(int cell=0; cell<CELLS; ++cell)
+                {
+                    if(cells[cell] != 0)
+                        continue;
+                    uint16_t _mask = candidates(cell, block_ids);
+                    unsigned int count = maskCount(_mask);
+                    if(count == 0)
+                        return -1;
+                    if(count < fewest)
+                    {
+                        fewest = count;
+                        best = cell;
+                        mask = _mask;
+                        if(count == 1)
+                            break;
+                    }
+                }
+                return best;
+            }
+        };
+
+        // state shared by every thread of one run
+        struct Shared
+        {
+            const Options* options;
+            std::chrono::steady_clock::time_point deadline;
+            unsigned long long limit;
+            std::atomic<unsigned long long> total;
+            std::atomic<int> reason;    // Status that stopped the walk, NO_REASON while running
+        };
+
+        struct Checkpoint
+        {
+            const char* filename;
+            std::chrono::microseconds interval;
+            std::chrono::steady_clock::time_point next;
+            SolutionWriter* writer;
+            const uint8_t* givens;
+            unsigned long long base_count;  // solutions found before the resumed run
+        };
+
+        class Walk
+        {
+        public:
+            Walk(Shared& shared, SolutionBuffer* out, Checkpoint* checkpoint=nullptr):
+                m_shared(shared),
+                m_out(out),
+                m_checkpoint(checkpoint),
+                m_block_ids(blockIds().data()),
+                m_prefer(nullptr),
+                m_found(nullptr),
+                m_count(0),
+                m_steps(0),
+                m_depth(0),
+                m_resume_depth(0)
+            {}
+
+            // try the digit of prefer first in every cell, copy the solutions into found
+            void steer(const uint8_t* prefer, uint8_t* found)
+            {
+                m_prefer = prefer;
+                m_found = found;
+            }
+
+            // skip the subtrees left of this path, which a previous run already walked
+            void resume(const std::vector<uint8_t>& cells, const std::vector<uint8_t>& values)
+            {
+                m_resume_depth = cells.size();
+                std::copy(cells.begin(), cells.end(), m_resume_cells);
+                std::copy(values.begin(), values.end(), m_resume_values);
+            }
+
+            void run(Board& board)
+            {
+                if(m_shared.reason.load(std::memory_order_relaxed) != NO_REASON)
+                    return;
+                if(m_depth >= m_resume_depth)
+                    m_resume_depth = 0;
+                if((++m_steps & 1023) == 0)
+                {
+                    if(interrupted())
+                        return;
+                    if(m_checkpoint != nullptr && m_resume_depth == 0 &&
+                        std::chrono::steady_clock::now() >= m_checkpoint->next)
+                    {
+                        save();
+                    }
+                }
+                uint16_t mask = 0;
+                int cell = board.pick(mask, m_block_ids);
+                if(cell < 0)
+                    return;
+                if(cell == CELLS)
+                {
+                    emit(board);
+                    return;
+                }
+                int first = 1;
+                if(m_resume_depth != 0)
+                {
+                    if(cell != m_resume_cells[m_depth])
+                        throw std::runtime_error("Checkpoint does not match the search tree");
+                    first = m_resume_values[m_depth];
+                }
+                int preferred = m_prefer != nullptr && (mask & (1 << m_prefer[cell]))? m_prefer[cell]: 0;
+                if(preferred != 0 && !branch(board, cell, preferred))
+                    return;
+                for(int value=first; value<=SIZE; ++value)
+                {
+                    if(value != preferred && (mask & (1 << value)) && !branch(board, cell, value))
+                        return;
+                }
+            }
+
+            unsigned long long getCount(void) {return m_count;}
+        private:
+            // false once the walk has to stop
+            bool branch(Board& board, int cell, int value)
+            {
+                board.place(cell, value, m_block_ids);
+                m_path_cells[m_depth] = cell;
+                m_path_values[m_depth] = value;
+                ++m_depth;
+                run(board);
+                --m_depth;
+                board.unplace(cell, value, m_block_ids);
+                m_resume_depth = 0;
+                return m_shared.reason.load(std::memory_order_relaxed) == NO_REASON;
+            }
+
+            // the node about to be walked, every solution before it is already in the output
+            void save(void)
+            {
+                if(m_out != nullptr)
+                    m_out->flush();
+                uint64_t position = m_checkpoint->writer != nullptr? m_checkpoint->writer->sync(): 0;
+                std::string temp = std::string(m_checkpoint->filename) + ".tmp";
+                FILE* f = std::fopen(temp.c_str(), "w");
+                if(f != nullptr)
+                {
+                    std::fprintf(f, "SDKE 1\ngivens ");
+                    for(int cell=0; cell<CELLS; ++cell)
+                        std::fputc('0' + m_checkpoint->givens[cell], f);
+                    std::fprintf(f, "\ncount %llu\noutput %llu\npath %d",
+                        m_checkpoint->base_count + m_count, static_cast<unsigned long long>(position), m_depth);
+                    for(int i=0; i<m_depth; ++i)
+                        std::fprintf(f, " %d %d", m_path_cells[i], m_path_values[i]);
+                    std::fprintf(f, "\n");
+                    if(std::fclose(f) == 0)
+                        std::rename(temp.c_str(), m_checkpoint->filename);
+                }
+                m_checkpoint->next = std::chrono::steady_clock::now() + m_checkpoint->interval;
+            }
+
+            void emit(const Board& board)
+            {
+                if(m_shared.limit != 0)
+                {
+                    unsigned long long total = m_shared.total.fetch_add(1) + 1;
+                    if(total > m_shared.limit)
+                    {
+                        stop(Status::IterLimit);
+                        return;
+                    }
+                    if(total == m_shared.limit)
+                        stop(Status::IterLimit);
+                }
+                ++m_count;
+                if(m_out != nullptr)
+                    m_out->append(board.cells);
+                if(m_found != nullptr)
+                    std::memcpy(m_found, board.cells, CELLS);
+            }
+
+            bool interrupted(void)
+            {
+                const Options& options = *m_shared.options;
+                if(options.cancel != nullptr && options.cancel->load(std::memory_order_relaxed))
+                    stop(Status::Cancelled);
+                else if(options.time_limit_us > 0 && std::chrono::steady_clock::now() >= m_shared.deadline)
+                    stop(Status::TimedOut);
+                return m_shared.reason.load() != NO_REASON;
+            }
+
+            void stop(Status status)
+            {
+                int expected = NO_REASON;
+                m_shared.reason.compare_exchange_strong(expected, static_cast<int>(status));
+            }
+
+            Shared& m_shared;
+            SolutionBuffer* m_out;
+            Checkpoint* m_checkpoint;
+            const uint8_t* m_block_ids;
+            const uint8_t* m_prefer;
+            uint8_t* m_found;
+            unsigned long long m_count;
+            unsigned int m_steps;
+            int m_depth;
+            uint8_t m_path_cells[CELLS];
+            uint8_t m_path_values[CELLS];
+            int m_resume_depth;     // 0 once the resumed path is reached
+            uint8_t m_resume_cells[CELLS];
+            uint8_t m_resume_values[CELLS];
+        };
+
+        Board makeBoard(const uint8_t grid[CELLS])
+        {
+            const uint8_t* block_ids = blockIds().data();
+            Board board;
+            std::fill(board.row, board.row + SIZE, 0);
+            std::fill(board.column, board.column + SIZE, 0);
+            std::fill(board.block, board.block + SIZE, 0);
+            std::fill(board.cells, board.cells + CELLS, 0);
+            for(int cell=0; cell<CELLS; ++cell)
+            {
+                if(grid[cell] != 0)
+                    board.place(cell, grid[cell], block_ids);
+            }
+            return board;
+        }
+
+        // expands the first branching cells until there are about target subtrees
+        std::vector<Board> split(const Board& root, size_t target)
+        {
+            const uint8_t* block_ids = blockIds().data();
+            std::vector<Board> frontier(1, root);
+            for(int depth=0; depth<4 && frontier.size()<target; ++depth)
+            {
+                std::vector<Board> next;
+                bool expanded = false;
+                for(auto& board: frontier)
+                {
+                    uint16_t mask = 0;
+                    int cell = board.pick(mask, block_ids);
+                    if(cell < 0)
+                        continue;
+                    if(cell == CELLS)
+                    {
+                        next.push_back(board);
+                        continue;
+                    }
+                    expanded = true;
+                    for(int value=1; value<=SIZE; ++value)
+                    {
+                        if(!(mask & (1 << value)))
+                            continue;
+                        next.push_back(board);
+                        next.back().place(cell, value, block_ids);
+                    }
+                }
+                frontier.swap(next);
+                if(!expanded)
+                    break;
+            }
+            return frontier;
+        }
+    }
+
+    SolutionWriter::SolutionWriter(FILE* file, Format format, uint64_t position):
+        m_file(file),
+        m_format(format),
+        m_position(position),
+        m_error(false)
+    {}
+
+    void SolutionWriter::write(const std::string& chunk)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if(std::fwrite(chunk.data(), 1, chunk.size(), m_file) != chunk.size())
+            m_error = true;
+        m_position += chunk.size();
+    }
+
+    uint64_t SolutionWriter::sync(void)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if(std::fflush(m_file) != 0)
+            m_error = true;
+        return m_position;
+    }
+
+    SolutionBuffer::SolutionBuffer(SolutionWriter* writer, size_t capacity):
+        m_writer(writer),
+        m_capacity(capacity)
+    {
+        m_buffer.reserve(capacity + CELLS + 1);
+    }
+
+    SolutionBuffer::~SolutionBuffer()
+    {
+        flush();
+    }
+
+    void SolutionBuffer::append(const uint8_t grid[CELLS])
+    {
+        if(m_writer->getFormat() == Format::Text)
+        {
+            char line[CELLS + 1];
+            for(int i=0; i<CELLS; ++i)
+                line[i] = '0' + grid[i];
+            line[CELLS] = '\n';
+            m_buffer.append(line, CELLS + 1);
+        }
+        else
+        {
+            char packed[PACKED_SIZE];
+            for(int i=0; i<PACKED_SIZE; ++i)
+                packed[i] = (grid[2 * i] << 4) | (2 * i + 1 < CELLS? grid[2 * i + 1]: 0);
+            m_buffer.append(packed, PACKED_SIZE);
+        }
+        if(m_buffer.size() >= m_capacity)
+            flush();
+    }
+
+    void SolutionBuffer::flush(void)
+    {
+        if(m_buffer.empty())
+            return;
+        m_writer->write(m_buffer);
+        m_buffer.clear();
+    }
+
+    Enumerator::Enumerator(const uint8_t grid[CELLS]):
+        m_status(Status::Solved),
+        m_resume_count(0),
+        m_resume_output(0)
+    {
+        // rejects out of range values and duplicated givens
+        Problem problem(grid);
+        std::copy(grid, grid + CELLS, m_grid);
+    }
+
+    unsigned long long Enumerator::run(SolutionWriter* writer, const Options& options,
+        unsigned int threads, unsigned long long limit)
+    {
+        Shared shared;
+        shared.options = &options;
+        shared.limit = limit;
+        shared.total = m_resume_count;
+        shared.reason = NO_REASON;
+        if(options.time_limit_us > 0)
+            shared.deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(options.time_limit_us);
+        if(options.state_file != nullptr && threads > 1)
+            throw std::runtime_error("Checkpointing an enumeration needs a single thread");
+
+        Board root = makeBoard(m_grid);
+
+        unsigned long long count = m_resume_count;
+        if(threads <= 1)
+        {
+            Checkpoint checkpoint{options.state_file, std::chrono::microseconds(options.checkpoint_interval_us),
+                std::chrono::steady_clock::now() + std::chrono::microseconds(options.checkpoint_interval_us),
+                writer, m_grid, m_resume_count};
+            std::unique_ptr<SolutionBuffer> out(writer == nullptr? nullptr: new SolutionBuffer(writer));
+            Walk walk(shared, out.get(), options.state_file != nullptr? &checkpoint: nullptr);
+            walk.resume(m_resume_cells, m_resume_values);
+            walk.run(root);
+            count += walk.getCount();
+        }
+        else
+        {
+            std::vector<Board> subtrees = split(root, threads * 16);
+            std::atomic<size_t> next(0);
+            std::vector<unsigned long long> counts(threads, 0);
+            std::vector<std::thread> workers;
+            for(unsigned int i=0; i<threads; ++i)
+            {
+                workers.push_back(std::thread([&, i]()
+                {
+                    std::unique_ptr<SolutionBuffer> out(writer == nullptr? nullptr: new SolutionBuffer(writer));
+                    Walk walk(shared, out.get());
+                    for(size_t j=next++; j<subtrees.size(); j=next++)
+                        walk.run(subtrees[j]);
+                    counts[i] = walk.getCount();
+                }));
+            }
+            for(auto& worker: workers)
+                worker.join();
+            for(auto _count: counts)
+                count += _count;
+        }
+        int reason = shared.reason.load();
+        m_status = reason == NO_REASON? Status::Solved: static_cast<Status>(reason);
+        return count;
+    }
+
+    bool Enumerator::resume(const char* filename)
+    {
+        std::ifstream f(filename);
+        std::string magic, key, givens;
+        int version, depth;
+        unsigned long long count, output;
+        if(!(f >> magic >> version >> key >> givens) || magic != "SDKE" || version != 1 || givens.size() != CELLS)
+            return false;
+        for(int cell=0; cell<CELLS; ++cell)
+        {
+            if(givens[cell] - '0' != m_grid[cell])
+                return false;
+        }
+        if(!(f >> key >> count >> key >> output >> key >> depth) || depth < 0 || depth > CELLS)
+            return false;
+        std::vector<uint8_t> cells, values;
+        for(int i=0; i<depth; ++i)
+        {
+            int cell, value;
+            if(!(f >> cell >> value) || cell < 0 || cell >= CELLS || value < 1 || value > SIZE)
+                return false;
+            cells.push_back(cell);
+            values.push_back(value);
+        }
+        m_resume_cells = cells;
+        m_resume_values = values;
+        m_resume_count = count;
+        m_resume_output = output;
+        return true;
+    }
+
+    unsigned long long countSolutions(const uint8_t grid[CELLS], unsigned long long limit)
+    {
+        Enumerator enumerator(grid);
+        return enumerator.run(nullptr, Options(), 1, limit);
+    }
+
+    bool hasSolutionWithout(const uint8_t grid[CELLS], int cell, int value)
+    {
+        const uint8_t* block_ids = blockIds().data();
+        Board board = makeBoard(grid);
+        uint16_t mask = board.candidates(cell, block_ids) & ~(1 << value);
+        Options options;
+        for(int _value=1; _value<=SIZE; ++_value)
+        {
+            if(!(mask & (1 << _value)))
+                continue;
+            Shared shared;
+            shared.options = &options;
+            shared.limit = 1;
+            shared.total = 0;
+            shared.reason = NO_REASON;
+            Walk walk(shared, nullptr);
+            board.place(cell, _value, block_ids);
+            walk.run(board);
+            board.unplace(cell, _value, block_ids);
+            if(walk.getCount() != 0)
+                return true;
+        }
+        return false;
+    }
+
+    bool findSolution(const uint8_t grid[CELLS], uint8_t out[CELLS], const uint8_t* prefer)
+    {
+        Board board = makeBoard(grid);
+        Options options;
+        Shared shared;
+        shared.options = &options;
+        shared.limit = 1;
+        shared.total = 0;
+        shared.reason = NO_REASON;
+        Walk walk(shared, nullptr);
+        walk.steer(prefer, out);
+        walk.run(board);
+        return walk.getCount() != 0;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef _ENUMERATOR_H
+#define _ENUMERATOR_H
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Sudoku/Sudoku.h"
+
+#define PACKED_SIZE 41  // two digits per byte, high nibble first
+
+namespace Sudoku
+{
+    enum class Format {
+        Text,       // 81 digits and a newline
+        Binary      // PACKED_SIZE bytes
+    };
+
+    // thread-safe sink, threads format into their own SolutionBuffer and hand over whole chunks
+    class SolutionWriter
+    {
+    public:
+        // position: bytes already in the file when resuming
+        SolutionWriter(FILE* file, Format format, uint64_t position=0);
+        Format getFormat(void) {return m_format;}
+        void write(const std::string& chunk);
+        // pushes the stdio buffer to the file, returns the byte position reached
+        uint64_t sync(void);
+        bool getError(void) {return m_error;}
+    private:
+        FILE* m_file;
+        Format m_format;
+        std::mutex m_mutex;
+        uint64_t m_position;
+        bool m_error;
+    };
+
+    class SolutionBuffer
+    {
+    public:
+        SolutionBuffer(SolutionWriter* writer, size_t capacity=1 << 20);
+        ~SolutionBuffer();
+        void append(const uint8_t grid[CELLS]);
+        void flush(void);
+    private:
+        SolutionWriter* m_writer;
+        size_t m_capacity;
+        std::string m_buffer;
+    };
+
+    /*
+     * Depth-first walk over every completion of a grid on row/column/block
+     * masks, branching on the cell with the fewest candidates. Memory does
+     * not grow with the solution count; with several threads the tree is
+     * split on its first branching cells and the subtrees are shared out.
+     */
+    class Enumerator
+    {
+    public:
+        // throws std::runtime_error on duplicated givens
+        Enumerator(const uint8_t grid[CELLS]);
+        // streams solutions into writer (nullptr to only count), stops after limit of them (0: all);
+        // with options.state_file the walk position and output position are saved there every
+        // options.checkpoint_interval_us (single thread only), the count includes resumed solutions
+        unsigned long long run(SolutionWriter* writer, const Options& options=Options(),
+            unsigned int threads=1, unsigned long long limit=0);
+        // continue the next run from a checkpoint of the same givens, false if there is none;
+        // the output must be cut back to getResumeOutput() bytes first
+        bool resume(const char* filename);
+        uint64_t getResumeOutput(void) {return m_resume_output;}
+        // Solved once the whole tree is walked, IterLimit once limit solutions were found
+        Status getStatus(void) {return m_status;}
+    private:
+        uint8_t m_grid[CELLS];
+        Status m_status;
+        std::vector<uint8_t> m_resume_cells;
+        std::vector<uint8_t> m_resume_values;
+        unsigned long long m_resume_count;
+        uint64_t m_resume_output;
+    };
+
+    // number of solutions, counting stops at limit (0: no limit)
+    unsigned long long countSolutions(const uint8_t grid[CELLS], unsigned long long limit=0);
+    // whether some solution of grid puts another digit than value into the (empty) cell
+    bool hasSolutionWithout(const uint8_t grid[CELLS], int cell, int value);
+    // first solution of grid (no duplicated givens) into out, trying the digit of prefer first in every
+    // cell; from a grid that mostly agrees with prefer the walk hardly branches
+    bool findSolution(const uint8_t grid[CELLS], uint8_t out[CELLS], const uint8_t* prefer=nullptr);
+};
+#endif
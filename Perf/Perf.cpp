@@ -0,0 +1,202 @@
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "Perf.h"
+
+namespace Sudoku
+{
+    namespace
+    {
+        void config(Counter counter, perf_event_attr& attr)
+        {
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            switch(counter)
+            {
+                case Counter::Cycles:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                    break;
+                case Counter::Instructions:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                    break;
+                case Counter::L1Misses:
+                    attr.type = PERF_TYPE_HW_CACHE;
+                    attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                    break;
+                case Counter::LlcMisses:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                    break;
+                case Counter::BranchMisses:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                    break;
+            }
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+        }
+    }
+
+    const char* toString(Counter counter)
+    {
+        switch(counter)
+        {
+            case Counter::Cycles:
+                return "cycles";
+            case Counter::Instructions:
+                return "instructions";
+            case Counter::L1Misses:
+                return "l1_misses";
+            case Counter::LlcMisses:
+                return "llc_misses";
+            case Counter::BranchMisses:
+                return "branch_misses";
+        }
+        return "unknown";
+    }
+
+    const char* toString(Phase phase)
+    {
+        switch(phase)
+        {
+            case Phase::Setup:
+                return "setup";
+            case Phase::Propagate:
+                return "propagate";
+            case Phase::Probe:
+                return "probe";
+            case Phase::Search:
+                return "search";
+        }
+        return "unknown";
+    }
+
+    bool PerfSample::any(void) const
+    {
+        for(int i=0; i<COUNTER_NUM; ++i)
+        {
+            if(valid[i])
+                return true;
+        }
+        return false;
+    }
+
+    void PerfSample::add(const PerfSample& other)
+    {
+        for(int i=0; i<COUNTER_NUM; ++i)
+        {
+            valid[i] = valid[i] || other.valid[i];
+            values[i] += other.values[i];
+        }
+    }
+
+    PerfSample operator-(const PerfSample& lhs, const PerfSample& rhs)
+    {
+        PerfSample sample;
+        for(int i=0; i<COUNTER_NUM; ++i)
+        {
+            sample.valid[i] = lhs.valid[i] && rhs.valid[i];
+            sample.values[i] = sample.valid[i]? lhs.values[i] - rhs.values[i]: 0;
+        }
+        return sample;
+    }
+
+    PerfCounters& PerfCounters::thread(void)
+    {
+        static thread_local PerfCounters counters;
+        return counters;
+    }
+
+    PerfCounters::PerfCounters():
+        m_group_fd(-1),
+        m_opened(0)
+    {
+        for(int i=0; i<COUNTER_NUM; ++i)
+        {
+            m_fds[i] = -1;
+            m_slots[i] = -1;
+            perf_event_attr attr;
+            config(static_cast<Counter>(i), attr);
+            attr.disabled = m_group_fd < 0? 1: 0;
+            int fd = syscall(__NR_perf_event_open, &attr, 0, -1, m_group_fd, 0);
+            if(fd < 0)
+                continue;
+            if(m_group_fd < 0)
+                m_group_fd = fd;
+            m_fds[i] = fd;
+            m_slots[i] = m_opened++;
+        }
+        if(m_group_fd >= 0)
+        {
+            ioctl(m_group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(m_group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    PerfCounters::~PerfCounters()
+    {
+        for(int i=0; i<COUNTER_NUM; ++i)
+        {
+            if(m_fds[i] >= 0)
+                close(m_fds[i]);
+        }
+    }
+
+    PerfSample PerfCounters::read(void) const
+    {
+        PerfSample sample;
+        if(m_group_fd < 0)
+            return sample;
+        uint64_t buffer[1 + COUNTER_NUM];
+        ssize_t expected = sizeof(uint64_t) * (1 + m_opened);
+        if(::read(m_group_fd, buffer, sizeof(buffer)) != expected)
+            return sample;
+        for(int i=0; i<COUNTER_NUM; ++i)
+        {
+            if(m_slots[i] < 0)
+                continue;
+            sample.valid[i] = true;
+            sample.values[i] = buffer[1 + m_slots[i]];
+        }
+        return sample;
+    }
+
+    void printPerf(std::ostream& os, const PerfSample& sample)
+    {
+        if(!sample.any())
+        {
+            os << "n/a";
+            return;
+        }
+        bool first = true;
+        for(int i=0; i<COUNTER_NUM; ++i)
+        {
+            if(!sample.valid[i])
+                continue;
+            os << (first? "": ", ") << sample.values[i] << " " << toString(static_cast<Counter>(i));
+            first = false;
+        }
+        if(sample.valid[0] && sample.valid[1] && sample.values[0] != 0)
+            os << " (IPC " << static_cast<double>(sample.values[1]) / sample.values[0] << ")";
+    }
+
+    void writePerfJson(std::ostream& os, const PerfSample& sample)
+    {
+        os << "{";
+        bool first = true;
+        for(int i=0; i<COUNTER_NUM; ++i)
+        {
+            if(!sample.valid[i])
+                continue;
+            os << (first? "": ", ") << "\"" << toString(static_cast<Counter>(i)) << "\": " << sample.values[i];
+            first = false;
+        }
+        os << "}";
+    }
+}
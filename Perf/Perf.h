@@ -0,0 +1,72 @@
+#ifndef _PERF_H
+#define _PERF_H
+
+#include <cstdint>
+#include <iostream>
+
+namespace Sudoku
+{
+    enum class Counter {
+        Cycles,
+        Instructions,
+        L1Misses,       // L1 data cache read misses
+        LlcMisses,      // last level cache misses
+        BranchMisses
+    };
+    #define COUNTER_NUM 5
+
+    // phases of the propagation engine, see Solver::solve
+    enum class Phase {
+        Setup,          // candidate generation
+        Propagate,      // singles, pairs, pointing and cage rules
+        Probe,          // failed-candidate lookahead
+        Search          // guesses and backtraces
+    };
+    #define PHASE_NUM 4
+
+    const char* toString(Counter counter);
+    const char* toString(Phase phase);
+
+    struct PerfSample
+    {
+        bool valid[COUNTER_NUM];    // false if the counter could not be opened
+        uint64_t values[COUNTER_NUM];
+
+        PerfSample():
+            valid(),
+            values()
+        {}
+        bool any(void) const;
+        uint64_t get(Counter counter) const {return values[static_cast<int>(counter)];}
+        void add(const PerfSample& other);
+    };
+
+    /*
+     * Hardware counters of the calling thread through perf_event_open, opened
+     * once per thread as a single group so a read is one syscall. Counters the
+     * kernel refuses (no PMU, perf_event_paranoid, containers) are simply
+     * reported as invalid; nothing fails if none can be opened.
+     */
+    class PerfCounters
+    {
+    public:
+        static PerfCounters& thread(void);
+        ~PerfCounters();
+        bool available(void) const {return m_group_fd >= 0;}
+        // snapshot of the running totals, differences of two snapshots measure the code in between
+        PerfSample read(void) const;
+    private:
+        PerfCounters();
+        int m_group_fd;
+        int m_fds[COUNTER_NUM];
+        int m_slots[COUNTER_NUM];   // position in the group read, -1 if not opened
+        int m_opened;
+    };
+
+    PerfSample operator-(const PerfSample& lhs, const PerfSample& rhs);
+    // one line, "n/a" if no counter is valid
+    void printPerf(std::ostream& os, const PerfSample& sample);
+    // JSON object with the valid counters
+    void writePerfJson(std::ostream& os, const PerfSample& sample);
+};
+#endif
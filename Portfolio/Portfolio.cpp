@@ -0,0 +1,131 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include "Portfolio.h"
+
+namespace Sudoku
+{
+    Portfolio::Portfolio(const std::vector<Options>& configs):
+        m_configs(configs),
+        m_wins(configs.size(), 0),
+        m_solve_num(0)
+    {
+        if(m_configs.empty())
+            throw std::runtime_error("Portfolio without any configuration");
+    }
+
+    std::vector<Options> Portfolio::defaultConfigs(unsigned int num)
+    {
+        std::vector<Options> configs;
+        for(unsigned int i=0; i<num; ++i)
+        {
+            Options config;
+            switch(i)
+            {
+                case 0:
+                    // the plain engine, so the portfolio is never worse than a single search
+                    break;
+                case 1:
+                    config.branching = Branching::Fewest;
+                    break;
+                default:
+                    config.branching = i % 2 == 0? Branching::Random: Branching::Pair;
+                    config.seed = i - 1;
+                    break;
+            }
+            configs.push_back(config);
+        }
+        return configs;
+    }
+
+    Status Portfolio::solve(const uint8_t grid[CELLS], const std::vector<Cage>& cages, const Regions& regions,
+        uint8_t out[CELLS], const Options& options, Stats* stats, int* winner)
+    {
+        std::atomic<bool> done(false);
+        std::mutex mutex;
+        std::condition_variable finished_cv;
+        unsigned int finished = 0;
+        int first = -1;
+        bool partial = false;
+        Status status = Status::Cancelled;
+        Stats first_stats;
+        std::copy(grid, grid + CELLS, out);
+
+        std::vector<std::thread> workers;
+        for(size_t i=0; i<m_configs.size(); ++i)
+        {
+            workers.push_back(std::thread([&, i]()
+            {
+                Options config = m_configs[i];
+                config.max_iters = options.max_iters;
+                config.time_limit_us = options.time_limit_us;
+                config.cancel = &done;
+                config.show_status = false;
+                config.perf_counters = options.perf_counters;
+                uint8_t result[CELLS];
+                Stats result_stats;
+                Status result_status = Sudoku::solve(grid, cages, regions, result, config, &result_stats);
+                bool definitive = result_status == Status::Solved ||
+                    result_status == Status::Unsolvable || result_status == Status::Invalid;
+                std::lock_guard<std::mutex> guard(mutex);
+                finished_cv.notify_one();
+                ++finished;
+                if(first >= 0 || result_status == Status::Cancelled)
+                    return;
+                if(definitive)
+                {
+                    first = i;
+                    done = true;
+                }
+                else if(partial)
+                {
+                    return;  // keep the first limit that was hit
+                }
+                partial = true;
+                status = result_status;
+                first_stats = result_stats;
+                std::copy(result, result + CELLS, out);
+            }));
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(first < 0 && finished < m_configs.size())
+            {
+                finished_cv.wait_for(lock, std::chrono::milliseconds(1));
+                if(options.cancel != nullptr && options.cancel->load(std::memory_order_relaxed))
+                {
+                    done = true;
+                    break;
+                }
+            }
+        }
+        done = true;
+        for(auto& worker: workers)
+            worker.join();
+
+        ++m_solve_num;
+        if(first >= 0)
+            ++m_wins[first];
+        else if(options.cancel != nullptr && options.cancel->load(std::memory_order_relaxed))
+            status = Status::Cancelled;
+        if(stats != nullptr)
+            *stats = first_stats;
+        if(winner != nullptr)
+            *winner = first;
+        return status;
+    }
+
+    void Portfolio::report(std::ostream& os)
+    {
+        os << "Portfolio wins over " << m_solve_num << " puzzles:\n";
+        for(size_t i=0; i<m_configs.size(); ++i)
+        {
+            os << "  [" << i << "] " << toString(m_configs[i].branching)
+                << ", seed " << m_configs[i].seed << ": " << m_wins[i] << " wins";
+            if(m_solve_num != 0)
+                os << " (" << 100.0 * m_wins[i] / m_solve_num << "%)";
+            os << "\n";
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef _PORTFOLIO_H
+#define _PORTFOLIO_H
+
+#include <vector>
+#include <iostream>
+#include "Sudoku/Sudoku.h"
+
+namespace Sudoku
+{
+    /*
+     * Races differently configured searches on one puzzle, one thread each.
+     * The first definitive answer (solved, unsolvable or invalid) wins and
+     * cancels the others; wins are counted per configuration across solves.
+     */
+    class Portfolio
+    {
+    public:
+        Portfolio(const std::vector<Options>& configs);
+        // pair/fewest/random branching with distinct seeds
+        static std::vector<Options> defaultConfigs(unsigned int num);
+        // limits (time, iterations, cancel) are taken from options, search settings from the configs
+        Status solve(const uint8_t grid[CELLS], const std::vector<Cage>& cages, const Regions& regions,
+            uint8_t out[CELLS], const Options& options=Options(), Stats* stats=nullptr, int* winner=nullptr);
+        const std::vector<Options>& getConfigs(void) {return m_configs;}
+        const std::vector<unsigned int>& getWins(void) {return m_wins;}
+        unsigned int getSolveNum(void) {return m_solve_num;}
+        void report(std::ostream& os);
+    private:
+        std::vector<Options> m_configs;
+        std::vector<unsigned int> m_wins;
+        unsigned int m_solve_num;
+    };
+};
+#endif
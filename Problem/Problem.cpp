@@ -8,61 +8,192 @@
 
 
 namespace Sudoku{
-    Problem::Problem():
-        m_solved(false)
+    Regions::Regions()
     {
-        m_matrix = std::array<std::array<int, 9>, 9>();
-        for(int row=0; row<SIZE; ++row)
+        static const std::shared_ptr<const Table> standard = []()
         {
-            for(int col=0; col<SIZE; ++col)
+            uint8_t ids[SIZE * SIZE];
+            for(int cell=0; cell<SIZE * SIZE; ++cell)
+                ids[cell] = computeBlockId(Coord(cell / SIZE, cell % SIZE));
+            return build(ids);
+        }();
+        m_table = standard;
+    }
+
+    Regions::Regions(const uint8_t ids[SIZE * SIZE]):
+        m_table(build(ids))
+    {}
+
+    std::shared_ptr<const Regions::Table> Regions::build(const uint8_t ids[SIZE * SIZE])
+    {
+        std::shared_ptr<Table> table(new Table());
+        table->standard = true;
+        for(int cell=0; cell<SIZE * SIZE; ++cell)
+        {
+            Coord coord(cell / SIZE, cell % SIZE);
+            if(ids[cell] >= SIZE || table->coords[ids[cell]].size() == SIZE)
             {
-                m_matrix[row][col] = 0;
-                m_unsolved.push_back(Coord(row, col));
+                throw std::runtime_error("Invalid region layout");
             }
+            if(ids[cell] != computeBlockId(coord))
+                table->standard = false;
+            table->ids[cell] = ids[cell];
+            table->coords[ids[cell]].push_back(coord);
         }
+        for(int i=0; i<SIZE; ++i)
+        {
+            for(int j=0; j<SIZE; ++j)
+            {
+                table->units[i][j] = i * SIZE + j;
+                table->units[SIZE + i][j] = j * SIZE + i;
+                table->units[2 * SIZE + i][j] = table->coords[i][j].first * SIZE + table->coords[i][j].second;
+            }
+        }
+        for(int cell=0; cell<SIZE * SIZE; ++cell)
+        {
+            int count = 0;
+            for(int other=0; other<SIZE * SIZE; ++other)
+            {
+                if(other != cell && (other / SIZE == cell / SIZE || other % SIZE == cell % SIZE ||
+                    ids[other] == ids[cell]))
+                {
+                    table->peers[cell][count++] = other;
+                }
+            }
+            table->peer_num[cell] = count;
+        }
+        return table;
+    }
+
+    Problem::Problem():
+        m_solved(false)
+    {
+        init();
     }
 
     Problem::Problem(const char* filename):
         m_solved(false)
     {
-        auto tic = std::chrono::system_clock::now();
-        m_matrix = std::array<std::array<int, 9>, 9>();
-        for(int row=0; row<SIZE; ++row)
-        {
-            for(int col=0; col<SIZE; ++col)
-            {
-                m_matrix[row][col] = 0;
-                m_unsolved.push_back(Coord(row, col));
-            }
-        }
+        auto tic = std::chrono::steady_clock::now();
+        init();
         std::ifstream f;
         f.open(filename);
         if(!f.is_open())
         {
-            std::cerr << "Failed to open file: " << filename << "\n";
-            exit(-1);
+            throw std::runtime_error(std::string("Failed to open file: ") + filename);
         }
         std::stringstream ss;
         ss << f.rdbuf();
         std::string line;
+        // placed once the whole file is read, the R line may follow them
+        std::vector<std::pair<Coord, int>> givens;
         while(std::getline(ss, line))
         {
+            if(!line.empty() && line[0] == 'R')
+            {
+                // R[sep]81 region digits, blanks allowed between them
+                uint8_t ids[SIZE * SIZE];
+                int count = 0;
+                for(size_t i=1; i<line.length(); ++i)
+                {
+                    char c = line[i];
+                    if(c == ' ' || c == '\t' || c == ',' || c == '\r')
+                        continue;
+                    if(c < '0' || c > '8' || count == SIZE * SIZE)
+                    {
+                        throw std::runtime_error("Invalid regions: " + line);
+                    }
+                    ids[count++] = c - '0';
+                }
+                if(count != SIZE * SIZE)
+                {
+                    throw std::runtime_error("Invalid regions: " + line);
+                }
+                setRegions(Regions(ids));
+                continue;
+            }
+            if(!line.empty() && line[0] == 'K')
+            {
+                // K[sep]sum[sep]rc[sep]rc...
+                std::stringstream cage_ss(line.substr(1));
+                Cage cage;
+                std::string cell;
+                if(!(cage_ss >> cage.sum))
+                {
+                    throw std::runtime_error("Invalid cage: " + line);
+                }
+                while(cage_ss >> cell)
+                {
+                    if(cell.length() != 2 || cell[0] < '0' || cell[0] > '8' ||
+                        cell[1] < '0' || cell[1] > '8')
+                    {
+                        throw std::runtime_error("Invalid cage: " + line);
+                    }
+                    cage.cells.push_back(Coord(cell[0] - '0', cell[1] - '0'));
+                }
+                addCage(cage);
+                continue;
+            }
             if (line.length() != 5)
             {
-                std::cerr << "Invalid line: " << line << "\n";
-                exit(-1);
+                throw std::runtime_error("Invalid line: " + line);
             }
             // row[sep]col[sep]value
             int row = line[0] - '0';
             int col = line[2] - '0';
             int value = line[4] - '0';
-            setCell(Coord(row, col), value);
+            if(row < 0 || row >= SIZE || col < 0 || col >= SIZE || value < 0 || value > SIZE)
+            {
+                throw std::runtime_error("Invalid line: " + line);
+            }
+            givens.push_back(std::make_pair(Coord(row, col), value));
         }
+        for(auto& given: givens)
+            setCell(given.first, given.second);
         #ifdef DEBUG
         std::cout << "[Problem] initialization: " << getTimeDiff(tic) << "us\n";
         #endif
     }
 
+    Problem::Problem(const uint8_t grid[SIZE * SIZE], const std::vector<Cage>& cages,
+        const Regions& regions):
+        m_regions(regions),
+        m_solved(false)
+    {
+        init();
+        for(auto& cage: cages)
+            addCage(cage);
+        for(int i=0; i<SIZE * SIZE; ++i)
+        {
+            if(grid[i] > SIZE)
+            {
+                throw std::runtime_error("Invalid value " + std::to_string(grid[i]));
+            }
+            if(grid[i] != 0)
+                setCell(Coord(i / SIZE, i % SIZE), grid[i]);
+        }
+    }
+
+    void Problem::init(void)
+    {
+        m_matrix = std::array<std::array<int, 9>, 9>();
+        m_row_mask.fill(0);
+        m_column_mask.fill(0);
+        m_block_mask.fill(0);
+        m_cages.clear();
+        m_cage_mask.clear();
+        for(auto& row: m_cage_id)
+            row.fill(-1);
+        for(int row=0; row<SIZE; ++row)
+        {
+            for(int col=0; col<SIZE; ++col)
+            {
+                m_matrix[row][col] = 0;
+                m_unsolved.push_back(Coord(row, col));
+            }
+        }
+    }
+
     void Problem::setCell(Coord coord, int value)
     {
         unsigned int row = coord.first, column = coord.second;
@@ -70,13 +201,32 @@ namespace Sudoku{
         {
             if(getCell(Coord(row, column)) == 0)
             {
-                if(valueInside(getRow(row), value) ||
-                    valueInside(getColumn(column), value) ||
-                    valueInside(flattenBlock(getBlock(computeBlockId(coord))), value))
+                unsigned int block_id = getBlockId(coord);
+                uint16_t bit = 1 << value;
+                if((m_row_mask[row] | m_column_mask[column] | m_block_mask[block_id]) & bit)
                 {
                     throw std::runtime_error("Duplicated value found");
                 }
+                int cage_id = m_cage_id[row][column];
+                if(cage_id >= 0)
+                {
+                    if(m_cage_mask[cage_id] & bit)
+                    {
+                        throw std::runtime_error("Duplicated value found in cage");
+                    }
+                    uint16_t cage_mask = m_cage_mask[cage_id] | bit;
+                    const Cage& cage = m_cages[cage_id];
+                    if(maskSum(cage_mask) > cage.sum ||
+                        (maskCount(cage_mask) == cage.cells.size() && maskSum(cage_mask) != cage.sum))
+                    {
+                        throw std::runtime_error("Cage sum mismatch");
+                    }
+                    m_cage_mask[cage_id] = cage_mask;
+                }
                 m_matrix[row][column] = value;
+                m_row_mask[row] |= bit;
+                m_column_mask[column] |= bit;
+                m_block_mask[block_id] |= bit;
                 auto it = std::find(m_unsolved.begin(), m_unsolved.end(), coord);
                 m_unsolved.erase(it);
                 if(m_unsolved.size() == 0)
@@ -91,23 +241,85 @@ namespace Sudoku{
         {
             if(m_matrix[row][column] != 0)
             {
+                uint16_t bit = ~(1 << m_matrix[row][column]);
+                m_row_mask[row] &= bit;
+                m_column_mask[column] &= bit;
+                m_block_mask[getBlockId(coord)] &= bit;
+                if(m_cage_id[row][column] >= 0)
+                    m_cage_mask[m_cage_id[row][column]] &= bit;
                 m_matrix[row][column] = 0;
                 m_unsolved.push_back(coord);
             }
         }
     }
 
-    std::array<std::array<int, 3>, 3> Problem::getBlock(unsigned int block_id)
+    void Problem::setRegions(const Regions& regions)
     {
-        std::array<std::array<int, 3>, 3> block;
-        for(int row=0; row<3; ++row)
+        std::array<uint16_t, 9> block_mask;
+        block_mask.fill(0);
+        for(int row=0; row<SIZE; ++row)
+        {
+            for(int col=0; col<SIZE; ++col)
+            {
+                int value = m_matrix[row][col];
+                if(value == 0)
+                    continue;
+                uint16_t& mask = block_mask[regions.getId(Coord(row, col))];
+                if(mask & (1 << value))
+                {
+                    throw std::runtime_error("Duplicated value found in region");
+                }
+                mask |= 1 << value;
+            }
+        }
+        m_regions = regions;
+        m_block_mask = block_mask;
+    }
+
+    void Problem::addCage(const Cage& cage)
+    {
+        if(cage.cells.empty() || cage.cells.size() > SIZE ||
+            cageCombinations(cage.cells.size(), cage.sum).empty())
+        {
+            throw std::runtime_error("Invalid cage with sum " + std::to_string(cage.sum));
+        }
+        int cage_id = m_cages.size();
+        uint16_t cage_mask = 0;
+        for(auto coord: cage.cells)
         {
-            for(int col=0; col<3; ++col)
+            if(coord.first >= SIZE || coord.second >= SIZE || m_cage_id[coord.first][coord.second] >= 0)
+            {
+                throw std::runtime_error("Cell of cage out of range or already caged");
+            }
+            int value = getCell(coord);
+            if(value != 0)
             {
-                block[row][col] = getCell(
-                    Coord((block_id / 3) * 3 + row, (block_id % 3) * 3 + col));
+                if(cage_mask & (1 << value))
+                {
+                    throw std::runtime_error("Duplicated value found in cage");
+                }
+                cage_mask |= 1 << value;
             }
         }
+        if(maskSum(cage_mask) > cage.sum ||
+            (maskCount(cage_mask) == cage.cells.size() && maskSum(cage_mask) != cage.sum))
+        {
+            throw std::runtime_error("Cage sum mismatch");
+        }
+        for(auto coord: cage.cells)
+            m_cage_id[coord.first][coord.second] = cage_id;
+        m_cages.push_back(cage);
+        m_cage_mask.push_back(cage_mask);
+    }
+
+    std::array<int, 9> Problem::getBlock(unsigned int block_id)
+    {
+        std::array<int, 9> block;
+        const std::vector<Coord>& coords = getBlockCoords(block_id);
+        for(int i=0; i<SIZE; ++i)
+        {
+            block[i] = getCell(coords[i]);
+        }
         return block;
     }
 
@@ -134,6 +346,7 @@ namespace Sudoku{
 
     void Problem::displayBlock(unsigned int block_id)
     {
-        print2DArray<3, 3>(getBlock(block_id));
+        printArray<9>(getBlock(block_id));
+        std::cout << "\n";
     }
 }
\ No newline at end of file
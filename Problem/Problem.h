@@ -1,13 +1,18 @@
 #ifndef _PROBLEM_H
 #define _PROBLEM_H
 #include <array>
+#include <cstdint>
+#include <memory>
 #include <utility>
+#include <vector>
 #include <iostream>
 #include <fstream>
 
 #include "Utilities/Utilities.h"
 
 #define SIZE 9
+#define FULL_MASK 0x3FE  // bit v set for v = 1..9
+#define MAX_PEERS 24     // row and column peers plus at most 8 more from an irregular region
 
 namespace Sudoku
 {
@@ -17,22 +22,108 @@ namespace Sudoku
         Block
     };
 
+    // Killer constraint: distinct values in the cells adding up to sum
+    struct Cage
+    {
+        int sum;
+        std::vector<Coord> cells;
+    };
+
+    // cell indices (row * 9 + column) of a precomputed peer list
+    struct CellRange
+    {
+        const uint8_t* first;
+        const uint8_t* last;
+        const uint8_t* begin(void) const {return first;}
+        const uint8_t* end(void) const {return last;}
+        size_t size(void) const {return last - first;}
+    };
+
+    /*
+     * Block layout, the standard 3x3 squares or any nine regions of nine cells
+     * (Jigsaw). Membership, units and peers are computed once per layout;
+     * copies share the tables.
+     */
+    class Regions
+    {
+    public:
+        Regions();
+        // region (0-8) of every cell, throws std::runtime_error unless each region has nine cells
+        Regions(const uint8_t ids[SIZE * SIZE]);
+        bool isStandard(void) const {return m_table->standard;}
+        unsigned int getId(Coord coord) const {return m_table->ids[coord.first * SIZE + coord.second];}
+        const uint8_t* getIds(void) const {return m_table->ids.data();}
+        const std::vector<Coord>& getCoords(unsigned int region) const {return m_table->coords[region];}
+        // cells of row i, column i and region i as units i, 9 + i and 18 + i
+        const std::array<std::array<uint8_t, SIZE>, 3 * SIZE>& getUnits(void) const {return m_table->units;}
+        CellRange getPeers(unsigned int cell) const
+        {
+            const uint8_t* peers = m_table->peers[cell].data();
+            return CellRange{peers, peers + m_table->peer_num[cell]};
+        }
+    private:
+        struct Table
+        {
+            bool standard;
+            std::array<uint8_t, SIZE * SIZE> ids;
+            std::array<std::vector<Coord>, SIZE> coords;
+            std::array<std::array<uint8_t, SIZE>, 3 * SIZE> units;
+            std::array<std::array<uint8_t, MAX_PEERS>, SIZE * SIZE> peers;
+            std::array<uint8_t, SIZE * SIZE> peer_num;
+        };
+        static std::shared_ptr<const Table> build(const uint8_t ids[SIZE * SIZE]);
+        std::shared_ptr<const Table> m_table;
+    };
+
     class Problem {
     public:
         Problem();
+        // a file may carry an "R <81 region digits>" line for irregular blocks
         Problem(const char* filename);
+        Problem(const uint8_t grid[SIZE * SIZE], const std::vector<Cage>& cages=std::vector<Cage>(),
+            const Regions& regions=Regions());
         void setCell(Coord coord, int value);
+        void addCage(const Cage& cage);
+        // throws if the cells already set repeat a value in a new region
+        void setRegions(const Regions& regions);
+        const Regions& getRegions(void) {return m_regions;}
+        unsigned int getBlockId(Coord coord) {return m_regions.getId(coord);}
+        const std::vector<Coord>& getBlockCoords(unsigned int block_id) {return m_regions.getCoords(block_id);}
+        const std::vector<Coord>& getBlockCoords(Coord coord) {return m_regions.getCoords(getBlockId(coord));}
         int getCell(Coord coord) {return m_matrix[coord.first][coord.second];};
-        std::array<std::array<int, 3>, 3> getBlock(unsigned int block_id);
+        std::array<int, 9> getBlock(unsigned int block_id);
         std::array<int, 9> getRow(unsigned int row);
         std::array<int, 9> getColumn(unsigned int column);
+        // values not yet used by the row, column, block and cage of the cell
+        uint16_t getCandidateMask(Coord coord)
+        {
+            uint16_t mask = FULL_MASK & ~(m_row_mask[coord.first] | m_column_mask[coord.second] |
+                m_block_mask[getBlockId(coord)]);
+            int cage_id = m_cage_id[coord.first][coord.second];
+            if(cage_id >= 0)
+                mask &= ~m_cage_mask[cage_id];
+            return mask;
+        }
+        unsigned int getCageNum(void) {return m_cages.size();}
+        const Cage& getCage(unsigned int cage_id) {return m_cages[cage_id];}
+        int getCageId(Coord coord) {return m_cage_id[coord.first][coord.second];}
+        // values already placed in the cage
+        uint16_t getCageMask(unsigned int cage_id) {return m_cage_mask[cage_id];}
         void display(void);
         void displayBlock(unsigned int block_id);
         std::vector<Coord> getUnsolved(void) {return m_unsolved;}
         bool getSolved(void) {return m_solved;}
     private:
+        void init(void);
         std::array<std::array<int, 9>, 9> m_matrix;
         std::vector<Coord> m_unsolved;
+        std::array<uint16_t, 9> m_row_mask;
+        std::array<uint16_t, 9> m_column_mask;
+        std::array<uint16_t, 9> m_block_mask;
+        Regions m_regions;
+        std::vector<Cage> m_cages;
+        std::vector<uint16_t> m_cage_mask;
+        std::array<std::array<int, 9>, 9> m_cage_id;  // -1 if the cell is not caged
         bool m_solved;
     };
 };
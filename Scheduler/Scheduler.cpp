@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include "Scheduler.h"
+#include "Session/Session.h"
+
+namespace Sudoku
+{
+    namespace
+    {
+        // longest finishing thread when every thread takes the next duration as soon as it is free
+        double listSchedule(const std::vector<double>& durations, const std::vector<size_t>& order,
+            unsigned int threads)
+        {
+            std::priority_queue<double, std::vector<double>, std::greater<double>> finish;
+            for(unsigned int i=0; i<threads; ++i)
+                finish.push(0);
+            double makespan = 0;
+            for(auto i: order)
+            {
+                double end = finish.top() + durations[i];
+                finish.pop();
+                finish.push(end);
+                makespan = std::max(makespan, end);
+            }
+            return makespan;
+        }
+
+        std::vector<size_t> sortedByCost(const std::vector<double>& costs)
+        {
+            std::vector<size_t> order(costs.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&costs](size_t a, size_t b)
+                {return costs[a] > costs[b];});
+            return order;
+        }
+    }
+
+    CostEstimate estimateCost(const uint8_t grid[CELLS])
+    {
+        CostEstimate estimate;
+        for(int cell=0; cell<CELLS; ++cell)
+        {
+            if(grid[cell] != 0)
+                ++estimate.clues;
+        }
+        try
+        {
+            Session session(grid);
+            while(true)
+            {
+                Hint hint = session.nextStep();
+                if(hint.technique != Technique::NakedSingle && hint.technique != Technique::HiddenSingle)
+                    break;
+                session.apply(hint);
+                if(session.getCell(hint.coord) == 0)
+                    return estimate;
+            }
+            for(int cell=0; cell<CELLS; ++cell)
+            {
+                Coord coord(cell / SIZE, cell % SIZE);
+                if(session.getCell(coord) != 0)
+                    continue;
+                unsigned int count = maskCount(session.getCandidates(coord));
+                if(count == 0)
+                    return estimate;
+                estimate.candidates += count;
+                if(count == 2)
+                    ++estimate.bivalue;
+            }
+        }
+        catch(const std::exception&)
+        {
+            return estimate;
+        }
+        // every missing clue weighs most, then the open candidates; bi-value cells are the guesses to come
+        estimate.cost = 8.0 * (CELLS - estimate.clues) + estimate.candidates + 4.0 * estimate.bivalue;
+        return estimate;
+    }
+
+    const char* toString(Order order)
+    {
+        switch(order)
+        {
+            case Order::Fifo:
+                return "fifo";
+            case Order::Lpt:
+                return "lpt";
+        }
+        return "unknown";
+    }
+
+    Scheduler::Scheduler(unsigned int threads, Order order):
+        m_threads(std::max(1u, threads)),
+        m_used_threads(m_threads),
+        m_order(order),
+        m_estimate_us(0),
+        m_makespan_us(0)
+    {}
+
+    void Scheduler::run(const std::vector<Grid>& puzzles, const Options& options,
+        std::vector<BatchResult>& results, std::function<void(size_t)> ready)
+    {
+        size_t num = puzzles.size();
+        results.assign(num, BatchResult());
+        m_costs.assign(num, 0);
+        m_solve_us.assign(num, 0);
+        m_used_threads = std::min<size_t>(m_threads, std::max<size_t>(1, num));
+        unsigned int threads = m_used_threads;
+
+        auto tic = std::chrono::steady_clock::now();
+        if(m_order == Order::Lpt)
+        {
+            std::atomic<size_t> next(0);
+            auto estimate = [&]()
+            {
+                for(size_t i=next++; i<num; i=next++)
+                    m_costs[i] = estimateCost(puzzles[i].data()).cost;
+            };
+            std::vector<std::thread> workers;
+            for(unsigned int t=1; t<threads; ++t)
+                workers.push_back(std::thread(estimate));
+            estimate();
+            for(auto& worker: workers)
+                worker.join();
+            m_dispatch = sortedByCost(m_costs);
+        }
+        else
+        {
+            m_dispatch.resize(num);
+            std::iota(m_dispatch.begin(), m_dispatch.end(), 0);
+        }
+        m_estimate_us = getTimeDiff(tic);
+
+        tic = std::chrono::steady_clock::now();
+        std::atomic<size_t> next(0);
+        std::mutex mutex;
+        std::condition_variable done_cv;
+        std::vector<char> done(num, 0);
+        auto work = [&](unsigned int thread)
+        {
+            for(size_t k=next++; k<num; k=next++)
+            {
+                size_t i = m_dispatch[k];
+                BatchResult& result = results[i];
+                result.status = solve(puzzles[i].data(), result.solution, options, &result.stats);
+                result.thread = thread;
+                m_solve_us[i] = result.stats.elapsed_us;
+                std::lock_guard<std::mutex> guard(mutex);
+                done[i] = 1;
+                done_cv.notify_one();
+            }
+        };
+        std::vector<std::thread> workers;
+        for(unsigned int t=0; t<threads; ++t)
+            workers.push_back(std::thread(work, t));
+        for(size_t i=0; i<num; ++i)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                done_cv.wait(lock, [&]() {return done[i] != 0;});
+            }
+            if(ready)
+                ready(i);
+        }
+        for(auto& worker: workers)
+            worker.join();
+        m_makespan_us = getTimeDiff(tic);
+    }
+
+    void Scheduler::report(std::ostream& os)
+    {
+        if(m_solve_us.empty())
+            return;
+        std::vector<size_t> fifo(m_solve_us.size());
+        std::iota(fifo.begin(), fifo.end(), 0);
+        double total = std::accumulate(m_solve_us.begin(), m_solve_us.end(), 0.0);
+        double longest = *std::max_element(m_solve_us.begin(), m_solve_us.end());
+        double fifo_us = listSchedule(m_solve_us, fifo, m_used_threads);
+        double lpt_us = listSchedule(m_solve_us, sortedByCost(m_solve_us), m_used_threads);
+        double dispatch_us = listSchedule(m_solve_us, m_dispatch, m_used_threads);
+        os << "Scheduled " << m_solve_us.size() << " puzzles " << toString(m_order) << " on " << m_used_threads
+            << " threads: makespan " << m_makespan_us << " us, estimates " << m_estimate_us << " us\n";
+        os << "  replayed with measured solve times: " << toString(m_order) << " " << dispatch_us
+            << " us, fifo " << fifo_us << " us (" << (fifo_us > 0? 100 * (fifo_us - dispatch_us) / fifo_us: 0)
+            << "% shorter), lpt on measured times " << lpt_us << " us, lower bound "
+            << std::max(total / m_used_threads, longest) << " us\n";
+    }
+};
@@ -0,0 +1,71 @@
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include <functional>
+#include <iostream>
+#include <vector>
+#include "Sudoku/Sudoku.h"
+
+namespace Sudoku
+{
+    struct CostEstimate
+    {
+        unsigned int clues;
+        unsigned int candidates;    // left in unsolved cells after singles propagation
+        unsigned int bivalue;       // unsolved cells with two candidates left
+        double cost;                // relative, only the order matters
+
+        CostEstimate():
+            clues(0),
+            candidates(0),
+            bivalue(0),
+            cost(0)
+        {}
+    };
+
+    // Session singles and hidden singles until none is left, no search; a contradiction costs 0
+    CostEstimate estimateCost(const uint8_t grid[CELLS]);
+
+    enum class Order {
+        Fifo,   // input order
+        Lpt     // most expensive estimate first
+    };
+
+    const char* toString(Order order);
+
+    struct BatchResult
+    {
+        Status status;
+        uint8_t solution[CELLS];
+        Stats stats;
+        unsigned int thread;
+    };
+
+    /*
+     * Solves a batch on a pool of threads, each taking the next puzzle of
+     * the dispatch order. Longest-processing-time order keeps pathological
+     * puzzles from being started last and leaving the other threads idle.
+     * Results are handed out in input order whatever the dispatch order.
+     */
+    class Scheduler
+    {
+    public:
+        Scheduler(unsigned int threads, Order order=Order::Lpt);
+        // results[i] answers puzzles[i], ready(i) is called on this thread in input order
+        // as soon as results up to i are in
+        void run(const std::vector<Grid>& puzzles, const Options& options, std::vector<BatchResult>& results,
+            std::function<void(size_t)> ready=nullptr);
+        // makespan against FIFO and LPT list schedules of the measured solve times
+        void report(std::ostream& os);
+    private:
+        unsigned int m_threads;
+        unsigned int m_used_threads;  // m_threads clamped to the size of the last batch
+        Order m_order;
+        std::vector<double> m_costs;
+        std::vector<size_t> m_dispatch;
+        std::vector<double> m_solve_us;
+        double m_estimate_us;
+        double m_makespan_us;
+    };
+};
+#endif
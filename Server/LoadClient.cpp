@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "Server.h"
+
+using namespace Sudoku;
+
+namespace
+{
+    struct Result
+    {
+        std::vector<double> latencies;  // us
+        unsigned long solved;
+        unsigned long failed;
+        bool broken;
+    };
+
+    int connectServer(const char* socket_path, int port)
+    {
+        int fd;
+        if(socket_path != nullptr)
+        {
+            sockaddr_un addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            std::strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if(fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+                return fd;
+        }
+        else
+        {
+            sockaddr_in addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            int on = 1;
+            if(fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+            {
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                return fd;
+            }
+        }
+        if(fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    bool writeAll(int fd, const std::string& data)
+    {
+        size_t offset = 0;
+        while(offset < data.size())
+        {
+            ssize_t length = write(fd, data.data() + offset, data.size() - offset);
+            if(length < 0 && errno == EINTR)
+                continue;
+            if(length <= 0)
+                return false;
+            offset += length;
+        }
+        return true;
+    }
+
+    bool readAll(int fd, char* buffer, size_t size)
+    {
+        size_t offset = 0;
+        while(offset < size)
+        {
+            ssize_t length = read(fd, buffer + offset, size - offset);
+            if(length < 0 && errno == EINTR)
+                continue;
+            if(length <= 0)
+                return false;
+            offset += length;
+        }
+        return true;
+    }
+
+    // keeps up to depth requests in flight on one connection
+    void runConnection(int fd, const std::vector<Request>& puzzles, unsigned long requests,
+        unsigned int depth, Result& result)
+    {
+        using Clock = std::chrono::steady_clock;
+        std::vector<Clock::time_point> sent(requests);
+        result.latencies.reserve(requests);
+        unsigned long next = 0, received = 0;
+        std::string out;
+        char frame[4 + RESPONSE_SIZE];
+        while(received < requests)
+        {
+            out.clear();
+            while(next < requests && next - received < depth)
+            {
+                Request request = puzzles[next % puzzles.size()];
+                request.id = next;
+                encodeRequest(request, out);
+                sent[next++] = Clock::now();
+            }
+            Response response;
+            if(!writeAll(fd, out) || !readAll(fd, frame, sizeof(frame)) ||
+                !decodeResponse(frame + 4, RESPONSE_SIZE, response) || response.id >= next)
+            {
+                result.broken = true;
+                return;
+            }
+            result.latencies.push_back(
+                std::chrono::duration<double, std::micro>(Clock::now() - sent[response.id]).count());
+            if(response.status == Status::Solved)
+                ++result.solved;
+            else
+                ++result.failed;
+            ++received;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* socket_path = nullptr;
+    const char* puzzle_file = nullptr;
+    int port = 0;
+    unsigned int connections = 4, depth = 8;
+    unsigned long requests = 10000;
+    for(int i=1; i<argc; ++i)
+    {
+        if(std::strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+            socket_path = argv[++i];
+        else if(std::strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+            port = std::atoi(argv[++i]);
+        else if(std::strcmp(argv[i], "--connections") == 0 && i + 1 < argc)
+            connections = std::max(1, std::atoi(argv[++i]));
+        else if(std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            depth = std::max(1, std::atoi(argv[++i]));
+        else if(std::strcmp(argv[i], "--requests") == 0 && i + 1 < argc)
+            requests = std::atol(argv[++i]);
+        else if(puzzle_file == nullptr)
+            puzzle_file = argv[i];
+        else
+        {
+            puzzle_file = nullptr;
+            break;
+        }
+    }
+    if(puzzle_file == nullptr || (socket_path == nullptr && port == 0))
+    {
+        std::fprintf(stderr, "Usage: %s (--socket P | --port N) [--connections C] [--depth D] "
+            "[--requests N] <puzzle file>\n", argv[0]);
+        return -1;
+    }
+    std::ifstream f(puzzle_file);
+    std::string line;
+    std::vector<Request> puzzles;
+    while(std::getline(f, line))
+    {
+        Request request;
+        if(parseGrid(line.data(), line.size(), request.grid))
+            puzzles.push_back(request);
+    }
+    if(puzzles.empty())
+    {
+        std::fprintf(stderr, "No puzzle in %s\n", puzzle_file);
+        return -1;
+    }
+
+    std::vector<int> fds;
+    for(unsigned int i=0; i<connections; ++i)
+    {
+        int fd = connectServer(socket_path, port);
+        if(fd < 0)
+        {
+            std::fprintf(stderr, "Failed to connect: %s\n", std::strerror(errno));
+            return -1;
+        }
+        fds.push_back(fd);
+    }
+    std::vector<Result> results(connections, Result{std::vector<double>(), 0, 0, false});
+    std::vector<std::thread> threads;
+    auto tic = std::chrono::steady_clock::now();
+    for(unsigned int i=0; i<connections; ++i)
+    {
+        unsigned long share = requests / connections + (i < requests % connections? 1: 0);
+        threads.push_back(std::thread(runConnection, fds[i], std::cref(puzzles), share, depth,
+            std::ref(results[i])));
+    }
+    for(auto& thread: threads)
+        thread.join();
+    double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - tic).count();
+    for(auto fd: fds)
+        close(fd);
+
+    std::vector<double> latencies;
+    unsigned long solved = 0, failed = 0;
+    bool broken = false;
+    for(auto& result: results)
+    {
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        solved += result.solved;
+        failed += result.failed;
+        broken |= result.broken;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p)
+    {
+        return latencies.empty()? 0.0: latencies[std::min(latencies.size() - 1,
+            static_cast<size_t>(p * latencies.size()))];
+    };
+    std::printf("%zu responses (%lu solved, %lu not) over %u connections x %u in flight in %.0f us\n",
+        latencies.size(), solved, failed, connections, depth, elapsed);
+    std::printf("throughput: %.0f req/s\n", latencies.size() / elapsed * 1e6);
+    std::printf("latency us: p50 %.1f  p99 %.1f  max %.1f\n", percentile(0.5), percentile(0.99),
+        latencies.empty()? 0.0: latencies.back());
+    if(broken)
+        std::fprintf(stderr, "Connection closed or protocol error before all responses arrived\n");
+    return broken? 1: 0;
+}
@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "Server.h"
+#include "Telemetry/Telemetry.h"
+
+namespace Sudoku
+{
+    namespace
+    {
+        void putU32(std::string& out, uint32_t value)
+        {
+            char bytes[4] = {static_cast<char>(value), static_cast<char>(value >> 8),
+                static_cast<char>(value >> 16), static_cast<char>(value >> 24)};
+            out.append(bytes, 4);
+        }
+
+        uint32_t getU32(const char* bytes)
+        {
+            const unsigned char* b = reinterpret_cast<const unsigned char*>(bytes);
+            return b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+        }
+
+        std::runtime_error systemError(const char* what)
+        {
+            return std::runtime_error(std::string(what) + ": " + std::strerror(errno));
+        }
+    }
+
+    uint32_t frameLength(const char* bytes)
+    {
+        return getU32(bytes);
+    }
+
+    void encodeRequest(const Request& request, std::string& out)
+    {
+        putU32(out, REQUEST_SIZE);
+        putU32(out, request.id);
+        out.append(reinterpret_cast<const char*>(request.grid), CELLS);
+    }
+
+    void encodeResponse(const Response& response, std::string& out)
+    {
+        putU32(out, RESPONSE_SIZE);
+        putU32(out, response.id);
+        out.push_back(static_cast<char>(response.status));
+        out.append(reinterpret_cast<const char*>(response.solution), CELLS);
+        putU32(out, response.iters);
+        putU32(out, response.guesses);
+        putU32(out, response.backtraces);
+        putU32(out, response.elapsed_us);
+    }
+
+    bool decodeRequest(const char* payload, size_t length, Request& request)
+    {
+        if(length != REQUEST_SIZE)
+            return false;
+        request.id = getU32(payload);
+        std::memcpy(request.grid, payload + 4, CELLS);
+        return true;
+    }
+
+    bool decodeResponse(const char* payload, size_t length, Response& response)
+    {
+        if(length != RESPONSE_SIZE || static_cast<uint8_t>(payload[4]) > static_cast<uint8_t>(Status::Cancelled))
+            return false;
+        response.id = getU32(payload);
+        response.status = static_cast<Status>(payload[4]);
+        std::memcpy(response.solution, payload + 5, CELLS);
+        const char* stats = payload + 5 + CELLS;
+        response.iters = getU32(stats);
+        response.guesses = getU32(stats + 4);
+        response.backtraces = getU32(stats + 8);
+        response.elapsed_us = getU32(stats + 12);
+        return true;
+    }
+
+    Server::Server(const ServerConfig& config):
+        m_config(config),
+        m_listen_fd(-1),
+        m_epoll_fd(-1),
+        m_wake_fd(-1),
+        m_stop(false),
+        m_served_num(0)
+    {
+        if(m_config.threads == 0)
+            m_config.threads = 1;
+        if(m_config.batch_size == 0)
+            m_config.batch_size = 1;
+        m_config.options.show_status = false;
+        // build the shared lookup tables now rather than inside the first request
+        Regions();
+        cageCombinations(1, 1);
+        m_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(m_wake_fd < 0)
+            throw systemError("eventfd");
+    }
+
+    Server::~Server()
+    {
+        for(auto& pair: m_connections)
+            ::close(pair.first);
+        if(m_listen_fd >= 0)
+        {
+            ::close(m_listen_fd);
+            if(!m_config.socket_path.empty())
+                unlink(m_config.socket_path.c_str());
+        }
+        if(m_epoll_fd >= 0)
+            ::close(m_epoll_fd);
+        ::close(m_wake_fd);
+    }
+
+    void Server::stop(void)
+    {
+        m_stop = true;
+        uint64_t one = 1;
+        ssize_t ret = write(m_wake_fd, &one, sizeof(one));
+        (void)ret;
+    }
+
+    void Server::listen(void)
+    {
+        if(!m_config.socket_path.empty())
+        {
+            sockaddr_un addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            if(m_config.socket_path.size() >= sizeof(addr.sun_path))
+                throw std::runtime_error("Socket path too long: " + m_config.socket_path);
+            std::strcpy(addr.sun_path, m_config.socket_path.c_str());
+            m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if(m_listen_fd < 0)
+                throw systemError("socket");
+            unlink(addr.sun_path);
+            if(bind(m_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+                throw systemError("bind");
+        }
+        else
+        {
+            sockaddr_in addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(m_config.port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            m_listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if(m_listen_fd < 0)
+                throw systemError("socket");
+            int on = 1;
+            setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            if(bind(m_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+                throw systemError("bind");
+        }
+        if(::listen(m_listen_fd, SOMAXCONN) < 0)
+            throw systemError("listen");
+        m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if(m_epoll_fd < 0)
+            throw systemError("epoll_create1");
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = m_listen_fd;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_listen_fd, &event);
+        event.data.fd = m_wake_fd;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &event);
+    }
+
+    void Server::run(void)
+    {
+        listen();
+        for(unsigned int i=0; i<m_config.threads; ++i)
+            m_workers.push_back(std::thread(&Server::work, this));
+        epoll_event events[64];
+        std::vector<Job> pending;
+        while(!m_stop)
+        {
+            int num = epoll_wait(m_epoll_fd, events, 64, -1);
+            if(num < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                throw systemError("epoll_wait");
+            }
+            for(int i=0; i<num; ++i)
+            {
+                int fd = events[i].data.fd;
+                if(fd == m_listen_fd)
+                {
+                    accept();
+                    continue;
+                }
+                if(fd == m_wake_fd)
+                {
+                    uint64_t count;
+                    while(read(m_wake_fd, &count, sizeof(count)) > 0);
+                    std::vector<std::shared_ptr<Connection>> ready;
+                    {
+                        std::lock_guard<std::mutex> guard(m_ready_mutex);
+                        ready.swap(m_ready);
+                    }
+                    for(auto& connection: ready)
+                        flush(connection);
+                    continue;
+                }
+                auto it = m_connections.find(fd);
+                if(it == m_connections.end())
+                    continue;
+                std::shared_ptr<Connection> connection = it->second;
+                if(events[i].events & EPOLLOUT)
+                    flush(connection);
+                if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                {
+                    if(!receive(connection, pending))
+                        close(connection);
+                }
+            }
+            // whatever arrived in this round goes out in as few batches as possible
+            dispatch(pending);
+        }
+        {
+            std::lock_guard<std::mutex> guard(m_queue_mutex);
+            m_queue.clear();
+        }
+        m_queue_cv.notify_all();
+        for(auto& worker: m_workers)
+            worker.join();
+        m_workers.clear();
+    }
+
+    void Server::accept(void)
+    {
+        while(true)
+        {
+            int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(fd < 0)
+                return;
+            if(m_config.socket_path.empty())
+            {
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            }
+            std::shared_ptr<Connection> connection(new Connection());
+            connection->fd = fd;
+            connection->closed = false;
+            connection->want_write = false;
+            epoll_event event;
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+            m_connections[fd] = connection;
+        }
+    }
+
+    bool Server::receive(const std::shared_ptr<Connection>& connection, std::vector<Job>& pending)
+    {
+        char buffer[1 << 16];
+        while(true)
+        {
+            ssize_t length = read(connection->fd, buffer, sizeof(buffer));
+            if(length > 0)
+            {
+                connection->in.append(buffer, length);
+                continue;
+            }
+            if(length == 0)
+                return false;
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+        size_t offset = 0;
+        std::string& in = connection->in;
+        while(in.size() - offset >= 4)
+        {
+            uint32_t length = getU32(in.data() + offset);
+            if(length != REQUEST_SIZE)
+                return false;
+            if(in.size() - offset - 4 < length)
+                break;
+            Job job;
+            job.connection = connection;
+            decodeRequest(in.data() + offset + 4, length, job.request);
+            pending.push_back(job);
+            offset += 4 + length;
+        }
+        in.erase(0, offset);
+        return true;
+    }
+
+    void Server::flush(const std::shared_ptr<Connection>& connection)
+    {
+        std::lock_guard<std::mutex> guard(connection->mutex);
+        if(connection->closed)
+            return;
+        size_t offset = 0;
+        while(offset < connection->out.size())
+        {
+            ssize_t length = write(connection->fd, connection->out.data() + offset,
+                connection->out.size() - offset);
+            if(length > 0)
+                offset += length;
+            else if(length < 0 && errno == EINTR)
+                continue;
+            else
+                break;
+        }
+        connection->out.erase(0, offset);
+        // only poll for writability while the kernel buffer is full
+        bool want_write = !connection->out.empty();
+        if(want_write != connection->want_write)
+        {
+            epoll_event event;
+            event.events = want_write? EPOLLIN | EPOLLOUT: EPOLLIN;
+            event.data.fd = connection->fd;
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, connection->fd, &event);
+            connection->want_write = want_write;
+        }
+    }
+
+    void Server::close(const std::shared_ptr<Connection>& connection)
+    {
+        {
+            std::lock_guard<std::mutex> guard(connection->mutex);
+            connection->closed = true;
+        }
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, connection->fd, nullptr);
+        ::close(connection->fd);
+        m_connections.erase(connection->fd);
+    }
+
+    void Server::dispatch(std::vector<Job>& pending)
+    {
+        if(pending.empty())
+            return;
+        // spread a round over the workers, at most batch_size requests per hand-off
+        size_t size = std::min<size_t>(m_config.batch_size,
+            (pending.size() + m_config.threads - 1) / m_config.threads);
+        {
+            std::lock_guard<std::mutex> guard(m_queue_mutex);
+            for(size_t begin=0; begin<pending.size(); begin+=size)
+            {
+                size_t end = std::min(pending.size(), begin + size);
+                m_queue.push_back(std::vector<Job>(pending.begin() + begin, pending.begin() + end));
+            }
+        }
+        m_queue_cv.notify_all();
+        pending.clear();
+    }
+
+    void Server::work(void)
+    {
+        std::string out;
+        std::vector<std::shared_ptr<Connection>> touched;
+        while(true)
+        {
+            std::vector<Job> batch;
+            {
+                std::unique_lock<std::mutex> lock(m_queue_mutex);
+                m_queue_cv.wait(lock, [this]() {return m_stop || !m_queue.empty();});
+                if(m_queue.empty())
+                    return;
+                batch.swap(m_queue.front());
+                m_queue.pop_front();
+            }
+            touched.clear();
+            size_t begin = 0;
+            while(begin < batch.size())
+            {
+                // consecutive jobs of one connection share a single append
+                std::shared_ptr<Connection>& connection = batch[begin].connection;
+                out.clear();
+                size_t end = begin;
+                for(; end<batch.size() && batch[end].connection == connection; ++end)
+                {
+                    Response response;
+                    Stats stats;
+                    response.id = batch[end].request.id;
+                    response.status = solve(batch[end].request.grid, response.solution, m_config.options, &stats);
+                    response.iters = stats.iters;
+                    response.guesses = stats.guesses;
+                    response.backtraces = stats.backtraces;
+                    response.elapsed_us = stats.elapsed_us;
+                    if(m_config.telemetry != nullptr)
+                    {
+                        m_config.telemetry->record(response.id, response.status, stats.elapsed_us,
+                            stats.guesses, stats.backtraces);
+                    }
+                    encodeResponse(response, out);
+                }
+                m_served_num += end - begin;
+                {
+                    std::lock_guard<std::mutex> guard(connection->mutex);
+                    if(!connection->closed)
+                        connection->out.append(out);
+                }
+                if(std::find(touched.begin(), touched.end(), connection) == touched.end())
+                    touched.push_back(connection);
+                begin = end;
+            }
+            {
+                std::lock_guard<std::mutex> guard(m_ready_mutex);
+                m_ready.insert(m_ready.end(), touched.begin(), touched.end());
+            }
+            uint64_t one = 1;
+            ssize_t ret = write(m_wake_fd, &one, sizeof(one));
+            (void)ret;
+        }
+    }
+}
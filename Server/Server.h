@@ -0,0 +1,124 @@
+#ifndef _SERVER_H
+#define _SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <deque>
+#include "Sudoku/Sudoku.h"
+
+/*
+ * Wire protocol, every frame is a little-endian uint32 payload length followed by the payload.
+ *   request:  uint32 id, 81 bytes grid (0 for empty)
+ *   response: uint32 id, uint8 status, 81 bytes grid,
+ *             uint32 iters, uint32 guesses, uint32 backtraces, uint32 elapsed_us
+ * Responses carry the id of their request and may come back out of order.
+ */
+#define REQUEST_SIZE (4 + CELLS)
+#define RESPONSE_SIZE (4 + 1 + CELLS + 16)
+
+namespace Sudoku
+{
+    class Telemetry;
+
+    struct Request
+    {
+        uint32_t id;
+        uint8_t grid[CELLS];
+    };
+
+    struct Response
+    {
+        uint32_t id;
+        Status status;
+        uint8_t solution[CELLS];
+        uint32_t iters;
+        uint32_t guesses;
+        uint32_t backtraces;
+        uint32_t elapsed_us;
+    };
+
+    // append a whole frame to out
+    void encodeRequest(const Request& request, std::string& out);
+    void encodeResponse(const Response& response, std::string& out);
+    // payload length announced by the 4-byte prefix of a frame
+    uint32_t frameLength(const char* bytes);
+    // payload without the length prefix
+    bool decodeRequest(const char* payload, size_t length, Request& request);
+    bool decodeResponse(const char* payload, size_t length, Response& response);
+
+    struct ServerConfig
+    {
+        std::string socket_path;    // Unix domain socket, used when not empty
+        int port;                   // TCP port on 127.0.0.1 otherwise
+        unsigned int threads;
+        unsigned int batch_size;    // requests handed to a worker at once
+        Options options;
+        Telemetry* telemetry;       // every answered request is recorded when set
+
+        ServerConfig():
+            port(0),
+            threads(1),
+            batch_size(16),
+            telemetry(nullptr)
+        {}
+    };
+
+    /*
+     * Single epoll thread for all sockets, decoded requests are grouped into
+     * batches for a fixed worker pool; workers hand encoded responses back
+     * through an eventfd so only the epoll thread ever touches a socket.
+     */
+    class Server
+    {
+    public:
+        Server(const ServerConfig& config);
+        ~Server();
+        // blocks until stop(), throws std::runtime_error if the socket cannot be set up
+        void run(void);
+        // async-signal-safe
+        void stop(void);
+        unsigned long getServedNum(void) {return m_served_num;}
+    private:
+        struct Connection
+        {
+            int fd;
+            bool closed;
+            bool want_write;
+            std::string in;
+            std::mutex mutex;   // guards out and closed
+            std::string out;
+        };
+        struct Job
+        {
+            std::shared_ptr<Connection> connection;
+            Request request;
+        };
+        void listen(void);
+        void accept(void);
+        bool receive(const std::shared_ptr<Connection>& connection, std::vector<Job>& pending);
+        void flush(const std::shared_ptr<Connection>& connection);
+        void close(const std::shared_ptr<Connection>& connection);
+        void dispatch(std::vector<Job>& pending);
+        void work(void);
+        ServerConfig m_config;
+        int m_listen_fd;
+        int m_epoll_fd;
+        int m_wake_fd;
+        std::atomic<bool> m_stop;
+        std::atomic<unsigned long> m_served_num;
+        std::unordered_map<int, std::shared_ptr<Connection>> m_connections;
+        std::vector<std::thread> m_workers;
+        std::mutex m_queue_mutex;
+        std::condition_variable m_queue_cv;
+        std::deque<std::vector<Job>> m_queue;
+        std::mutex m_ready_mutex;
+        std::vector<std::shared_ptr<Connection>> m_ready;
+    };
+};
+#endif
@@ -0,0 +1,330 @@
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "Session.h"
+#include "Enumerator/Enumerator.h"
+
+namespace Sudoku
+{
+    namespace
+    {
+        Unit unitType(int unit)
+        {
+            return unit < SIZE? Unit::Row: (unit < 2 * SIZE? Unit::Column: Unit::Block);
+        }
+
+        int lowestValue(uint16_t mask)
+        {
+            return __builtin_ctz(mask);
+        }
+    }
+
+    const char* toString(Technique technique)
+    {
+        switch(technique)
+        {
+            case Technique::None:
+                return "none";
+            case Technique::NakedSingle:
+                return "naked single";
+            case Technique::HiddenSingle:
+                return "hidden single";
+            case Technique::NakedPair:
+                return "naked pair";
+            case Technique::Pointing:
+                return "pointing";
+        }
+        return "unknown";
+    }
+
+    Session::Session(const uint8_t puzzle[CELLS]):
+        m_eliminated(false),
+        m_has_solution(false),
+        m_unsolvable(false),
+        m_stuck(false),
+        m_mismatch(0)
+    {
+        std::memcpy(m_puzzle, puzzle, CELLS);
+        std::memset(m_grid, 0, CELLS);
+        std::memset(m_row_mask, 0, sizeof(m_row_mask));
+        std::memset(m_column_mask, 0, sizeof(m_column_mask));
+        std::memset(m_block_mask, 0, sizeof(m_block_mask));
+        for(int cell=0; cell<CELLS; ++cell)
+            m_candidates[cell] = FULL_MASK;
+        for(int cell=0; cell<CELLS; ++cell)
+        {
+            if(puzzle[cell] > SIZE)
+                throw std::runtime_error("Invalid value " + std::to_string(puzzle[cell]));
+            if(puzzle[cell] != 0 && !set(Coord(cell / SIZE, cell % SIZE), puzzle[cell]))
+                throw std::runtime_error("Duplicated value found");
+        }
+    }
+
+    bool Session::set(Coord coord, int value)
+    {
+        unsigned int cell = index(coord);
+        if(value < 1 || value > SIZE || (m_puzzle[cell] != 0 && m_grid[cell] != 0))
+            return false;
+        if(m_grid[cell] == value)
+            return true;
+        unsigned int row = coord.first, column = coord.second, block_id = computeBlockId(coord);
+        uint16_t bit = 1 << value;
+        if((m_row_mask[row] | m_column_mask[column] | m_block_mask[block_id]) & bit)
+            return false;
+        if(m_grid[cell] != 0)
+            clear(coord);
+        m_grid[cell] = value;
+        m_row_mask[row] |= bit;
+        m_column_mask[column] |= bit;
+        m_block_mask[block_id] |= bit;
+        m_candidates[cell] = 0;
+        for(auto peer: m_regions.getPeers(cell))
+            m_candidates[peer] &= ~bit;
+        if(m_has_solution && value != m_solution[cell])
+            ++m_mismatch;
+        return true;
+    }
+
+    bool Session::clear(Coord coord)
+    {
+        unsigned int cell = index(coord);
+        if(m_grid[cell] == 0 || m_puzzle[cell] != 0)
+            return false;
+        unsigned int row = coord.first, column = coord.second, block_id = computeBlockId(coord);
+        uint16_t bit = 1 << m_grid[cell];
+        if(m_has_solution && m_grid[cell] != m_solution[cell])
+            --m_mismatch;
+        m_stuck = false;
+        m_grid[cell] = 0;
+        m_row_mask[row] &= ~bit;
+        m_column_mask[column] &= ~bit;
+        m_block_mask[block_id] &= ~bit;
+        if(m_eliminated)
+        {
+            // eliminations found on the old grid may no longer hold anywhere
+            for(int i=0; i<CELLS; ++i)
+                refresh(i);
+            m_eliminated = false;
+        }
+        else
+        {
+            refresh(cell);
+            for(auto peer: m_regions.getPeers(cell))
+                refresh(peer);
+        }
+        return true;
+    }
+
+    void Session::refresh(unsigned int cell)
+    {
+        if(m_grid[cell] != 0)
+        {
+            m_candidates[cell] = 0;
+            return;
+        }
+        Coord coord(cell / SIZE, cell % SIZE);
+        m_candidates[cell] = FULL_MASK & ~(m_row_mask[coord.first] | m_column_mask[coord.second] |
+            m_block_mask[computeBlockId(coord)]);
+    }
+
+    Hint Session::nextStep(void)
+    {
+        Hint hint;
+        if(findNakedSingle(hint) || findHiddenSingle(hint) || findNakedPair(hint) || findPointing(hint))
+            return hint;
+        return Hint();
+    }
+
+    bool Session::findNakedSingle(Hint& hint)
+    {
+        for(int cell=0; cell<CELLS; ++cell)
+        {
+            uint16_t mask = m_candidates[cell];
+            if(m_grid[cell] == 0 && mask != 0 && (mask & (mask - 1)) == 0)
+            {
+                hint.technique = Technique::NakedSingle;
+                hint.coord = Coord(cell / SIZE, cell % SIZE);
+                hint.value = lowestValue(mask);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Session::findHiddenSingle(Hint& hint)
+    {
+        for(int unit=0; unit<3 * SIZE; ++unit)
+        {
+            uint16_t once = 0, twice = 0;
+            for(auto cell: m_regions.getUnits()[unit])
+            {
+                twice |= once & m_candidates[cell];
+                once |= m_candidates[cell];
+            }
+            uint16_t singles = once & ~twice;
+            if(singles == 0)
+                continue;
+            int value = lowestValue(singles);
+            for(auto cell: m_regions.getUnits()[unit])
+            {
+                if(m_candidates[cell] & (1 << value))
+                {
+                    hint.technique = Technique::HiddenSingle;
+                    hint.unit = unitType(unit);
+                    hint.coord = Coord(cell / SIZE, cell % SIZE);
+                    hint.value = value;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool Session::findNakedPair(Hint& hint)
+    {
+        for(int unit=0; unit<3 * SIZE; ++unit)
+        {
+            const uint8_t* cells = m_regions.getUnits()[unit].data();
+            for(int i=0; i<SIZE; ++i)
+            {
+                uint16_t pair = m_candidates[cells[i]];
+                if(maskCount(pair) != 2)
+                    continue;
+                for(int j=i+1; j<SIZE; ++j)
+                {
+                    if(m_candidates[cells[j]] != pair)
+                        continue;
+                    // only a hint if some other cell of the unit loses a candidate
+                    for(int k=0; k<SIZE; ++k)
+                    {
+                        if(k == i || k == j || !(m_candidates[cells[k]] & pair))
+                            continue;
+                        hint.technique = Technique::NakedPair;
+                        hint.unit = unitType(unit);
+                        hint.coord = Coord(cells[i] / SIZE, cells[i] % SIZE);
+                        hint.other = Coord(cells[j] / SIZE, cells[j] % SIZE);
+                        hint.values = pair;
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    bool Session::findPointing(Hint& hint)
+    {
+        for(int block_id=0; block_id<SIZE; ++block_id)
+        {
+            const uint8_t* cells = m_regions.getUnits()[2 * SIZE + block_id].data();
+            for(int value=1; value<=SIZE; ++value)
+            {
+                uint16_t bit = 1 << value;
+                int rows = 0, columns = 0, first = -1;
+                for(int i=0; i<SIZE; ++i)
+                {
+                    if(!(m_candidates[cells[i]] & bit))
+                        continue;
+                    rows |= 1 << (cells[i] / SIZE);
+                    columns |= 1 << (cells[i] % SIZE);
+                    if(first < 0)
+                        first = cells[i];
+                }
+                if(first < 0)
+                    continue;
+                bool same_row = (rows & (rows - 1)) == 0, same_column = (columns & (columns - 1)) == 0;
+                // the line must have the value outside of the block to be worth a hint
+                for(int i=0; i<SIZE; ++i)
+                {
+                    int cell = same_row? (first / SIZE) * SIZE + i: i * SIZE + first % SIZE;
+                    if(!(same_row || same_column) ||
+                        computeBlockId(Coord(cell / SIZE, cell % SIZE)) == static_cast<unsigned int>(block_id) ||
+                        !(m_candidates[cell] & bit))
+                    {
+                        continue;
+                    }
+                    hint.technique = Technique::Pointing;
+                    hint.unit = same_row? Unit::Row: Unit::Column;
+                    hint.coord = Coord(first / SIZE, first % SIZE);
+                    hint.values = bit;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void Session::apply(const Hint& hint)
+    {
+        switch(hint.technique)
+        {
+            case Technique::None:
+                return;
+
+            case Technique::NakedSingle:
+            case Technique::HiddenSingle:
+                set(hint.coord, hint.value);
+                return;
+
+            case Technique::NakedPair:
+            case Technique::Pointing:
+            {
+                // remove the values from the unit of the hint, except the cells forming the pattern
+                unsigned int first = index(hint.coord);
+                int unit;
+                if(hint.unit == Unit::Row)
+                    unit = hint.coord.first;
+                else if(hint.unit == Unit::Column)
+                    unit = SIZE + hint.coord.second;
+                else
+                    unit = 2 * SIZE + computeBlockId(hint.coord);
+                unsigned int block_id = computeBlockId(hint.coord);
+                for(auto cell: m_regions.getUnits()[unit])
+                {
+                    Coord coord(cell / SIZE, cell % SIZE);
+                    if(hint.technique == Technique::NakedPair &&
+                        (cell == first || cell == index(hint.other)))
+                        continue;
+                    if(hint.technique == Technique::Pointing && computeBlockId(coord) == block_id)
+                        continue;
+                    m_candidates[cell] &= ~hint.values;
+                }
+                m_eliminated = true;
+                return;
+            }
+        }
+    }
+
+    bool Session::solvable(void)
+    {
+        for(int cell=0; cell<CELLS; ++cell)
+        {
+            if(m_grid[cell] == 0 && m_candidates[cell] == 0)
+                return false;
+        }
+        if(!m_has_solution && !m_unsolvable)
+        {
+            m_has_solution = findSolution(m_puzzle, m_solution);
+            m_unsolvable = !m_has_solution;
+            for(int cell=0; cell<CELLS && m_has_solution; ++cell)
+            {
+                if(m_grid[cell] != 0 && m_grid[cell] != m_solution[cell])
+                    ++m_mismatch;
+            }
+        }
+        if(m_unsolvable || m_stuck)
+            return false;
+        if(m_mismatch == 0)
+            return true;
+        // the player left the known solution; a search preferring its digits only branches where they clash
+        uint8_t solution[CELLS];
+        if(!findSolution(m_grid, solution, m_solution))
+        {
+            m_stuck = true;
+            return false;
+        }
+        std::memcpy(m_solution, solution, CELLS);
+        m_mismatch = 0;
+        return true;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef _SESSION_H
+#define _SESSION_H
+
+#include "Sudoku/Sudoku.h"
+
+namespace Sudoku
+{
+    enum class Technique {
+        None,
+        NakedSingle,    // only one aux in the cell
+        HiddenSingle,   // aux number only appears in one cell of the unit
+        NakedPair,      // two cells of the unit share the same two aux numbers
+        Pointing        // aux number of a block confined to one row/column
+    };
+
+    const char* toString(Technique technique);
+
+    struct Hint
+    {
+        Technique technique;
+        Unit unit;         // unit the rule was found in
+        Coord coord;       // cell to set (singles) or first cell of the pattern
+        Coord other;       // second cell of a pair
+        int value;         // value to set, 0 for eliminations
+        uint16_t values;   // candidates eliminated from the rest of the unit
+
+        Hint():
+            technique(Technique::None),
+            unit(Unit::Row),
+            value(0),
+            values(0)
+        {}
+    };
+
+    /*
+     * Interactive play on one puzzle: keeps the grid and the candidate of
+     * every cell, edits only touch the peers of the edited cell. The hint
+     * rules are the solver's techniques re-done on candidate masks rather
+     * than calls into Solver, whose versions work on its aux map inside
+     * solve().
+     */
+    class Session
+    {
+    public:
+        Session(const uint8_t puzzle[CELLS]);
+        // false if the cell is a given or the value is already used by a peer
+        bool set(Coord coord, int value);
+        bool clear(Coord coord);
+        int getCell(Coord coord) {return m_grid[index(coord)];}
+        uint16_t getCandidates(Coord coord) {return m_candidates[index(coord)];}
+        Hint nextStep(void);
+        // remove the candidates the hint rules out (or set its value)
+        void apply(const Hint& hint);
+        // exact; repairs the last solution found around the player's entries instead of solving anew
+        bool solvable(void);
+    private:
+        static unsigned int index(Coord coord) {return coord.first * SIZE + coord.second;}
+        void refresh(unsigned int cell);
+        bool findNakedSingle(Hint& hint);
+        bool findHiddenSingle(Hint& hint);
+        bool findNakedPair(Hint& hint);
+        bool findPointing(Hint& hint);
+        Regions m_regions;
+        uint8_t m_puzzle[CELLS];
+        uint8_t m_grid[CELLS];
+        uint16_t m_candidates[CELLS];   // 0 for filled cells
+        uint16_t m_row_mask[SIZE];
+        uint16_t m_column_mask[SIZE];
+        uint16_t m_block_mask[SIZE];
+        bool m_eliminated;              // candidates narrowed by apply() beyond the unit masks
+        bool m_has_solution;
+        bool m_unsolvable;              // the puzzle itself has no solution
+        bool m_stuck;                   // no solution extends the grid, until the next clear
+        uint8_t m_solution[CELLS];      // last solution found
+        unsigned int m_mismatch;        // filled cells disagreeing with m_solution
+    };
+};
+#endif
@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "Shard.h"
+
+namespace Sudoku
+{
+    namespace
+    {
+        double nowUs(void)
+        {
+            return std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        bool writeAll(int fd, const std::string& data)
+        {
+            size_t offset = 0;
+            while(offset < data.size())
+            {
+                ssize_t length = write(fd, data.data() + offset, data.size() - offset);
+                if(length < 0 && errno == EINTR)
+                    continue;
+                if(length <= 0)
+                    return false;
+                offset += length;
+            }
+            return true;
+        }
+    }
+
+    Coordinator::Coordinator(const ShardConfig& config):
+        m_config(config),
+        m_elapsed_us(0),
+        m_puzzle_num(0),
+        m_retry_num(0),
+        m_failed_shard_num(0)
+    {
+        if(m_config.command.empty())
+            throw std::runtime_error("Coordinator without a worker command");
+        m_config.workers = std::max(1u, m_config.workers);
+        m_config.shard_size = std::max(1u, m_config.shard_size);
+        m_config.max_attempts = std::max(1u, m_config.max_attempts);
+        Worker worker;
+        worker.pid = -1;
+        worker.fd = -1;
+        worker.shard = -1;
+        worker.out_offset = 0;
+        worker.started_us = 0;
+        worker.shards = 0;
+        worker.puzzles = 0;
+        worker.busy_us = 0;
+        worker.restarts = 0;
+        m_workers.assign(m_config.workers, worker);
+    }
+
+    Coordinator::~Coordinator()
+    {
+        for(auto& worker: m_workers)
+            reap(worker);
+    }
+
+    bool Coordinator::spawn(Worker& worker)
+    {
+        int fds[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+            return false;
+        pid_t pid = fork();
+        if(pid < 0)
+        {
+            close(fds[0]);
+            close(fds[1]);
+            return false;
+        }
+        if(pid == 0)
+        {
+            // dup2 clears close-on-exec on the copies
+            dup2(fds[1], 0);
+            dup2(fds[1], 1);
+            std::vector<char*> argv;
+            for(auto& arg: m_config.command)
+                argv.push_back(const_cast<char*>(arg.c_str()));
+            argv.push_back(nullptr);
+            execv(argv[0], argv.data());
+            _exit(127);
+        }
+        close(fds[1]);
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+        worker.pid = pid;
+        worker.fd = fds[0];
+        worker.shard = -1;
+        worker.in.clear();
+        worker.out.clear();
+        worker.out_offset = 0;
+        return true;
+    }
+
+    void Coordinator::reap(Worker& worker)
+    {
+        if(worker.fd >= 0)
+            close(worker.fd);
+        if(worker.pid > 0)
+        {
+            kill(worker.pid, SIGTERM);
+            waitpid(worker.pid, nullptr, 0);
+        }
+        worker.fd = -1;
+        worker.pid = -1;
+        worker.shard = -1;
+    }
+
+    bool Coordinator::run(const std::vector<Grid>& puzzles, std::vector<Response>& results,
+        std::function<void(size_t)> ready)
+    {
+        double tic = nowUs();
+        results.assign(puzzles.size(), Response());
+        std::vector<char> done(puzzles.size(), 0);
+        std::vector<Shard> shards;
+        std::deque<int> queue;
+        for(size_t begin=0; begin<puzzles.size(); begin+=m_config.shard_size)
+        {
+            size_t end = std::min(puzzles.size(), begin + m_config.shard_size);
+            queue.push_back(shards.size());
+            shards.push_back(Shard{begin, end, end - begin, 0});
+        }
+        size_t finished = 0, next_ready = 0;
+        bool complete = true;
+        unsigned int spawn_budget = m_config.workers * m_config.max_attempts;
+        for(auto& worker: m_workers)
+        {
+            if(worker.fd < 0 && !spawn(worker))
+                throw std::runtime_error(std::string("Failed to start worker: ") + std::strerror(errno));
+        }
+
+        auto giveUp = [&](int shard_id)
+        {
+            Shard& shard = shards[shard_id];
+            for(size_t i=shard.begin; i<shard.end; ++i)
+            {
+                if(done[i])
+                    continue;
+                done[i] = 1;
+                results[i].id = i;
+                results[i].status = Status::Cancelled;
+                std::copy(puzzles[i].begin(), puzzles[i].end(), results[i].solution);
+                results[i].iters = results[i].guesses = results[i].backtraces = results[i].elapsed_us = 0;
+            }
+            shard.remaining = 0;
+            ++m_failed_shard_num;
+            ++finished;
+            complete = false;
+        };
+
+        while(finished < shards.size())
+        {
+            bool alive = false;
+            for(auto& worker: m_workers)
+            {
+                if(worker.fd >= 0)
+                    alive = true;
+                if(worker.fd < 0 || worker.shard >= 0 || queue.empty())
+                    continue;
+                worker.shard = queue.front();
+                queue.pop_front();
+                Shard& shard = shards[worker.shard];
+                ++shard.attempts;
+                worker.started_us = nowUs();
+                for(size_t i=shard.begin; i<shard.end; ++i)
+                {
+                    if(done[i])
+                        continue;
+                    Request request;
+                    request.id = i;
+                    std::copy(puzzles[i].begin(), puzzles[i].end(), request.grid);
+                    encodeRequest(request, worker.out);
+                }
+            }
+            if(!alive)
+            {
+                // every slot exhausted its restarts
+                while(!queue.empty())
+                {
+                    giveUp(queue.front());
+                    queue.pop_front();
+                }
+                break;
+            }
+
+            std::vector<pollfd> fds;
+            std::vector<Worker*> polled;
+            for(auto& worker: m_workers)
+            {
+                if(worker.fd < 0)
+                    continue;
+                pollfd fd;
+                fd.fd = worker.fd;
+                fd.events = POLLIN | (worker.out_offset < worker.out.size()? POLLOUT: 0);
+                fd.revents = 0;
+                fds.push_back(fd);
+                polled.push_back(&worker);
+            }
+            if(poll(fds.data(), fds.size(), -1) < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                throw std::runtime_error(std::string("poll: ") + std::strerror(errno));
+            }
+            for(size_t k=0; k<fds.size(); ++k)
+            {
+                Worker& worker = *polled[k];
+                bool dead = false;
+                if(fds[k].revents & POLLOUT)
+                {
+                    ssize_t length = send(worker.fd, worker.out.data() + worker.out_offset,
+                        worker.out.size() - worker.out_offset, MSG_NOSIGNAL);
+                    if(length > 0)
+                        worker.out_offset += length;
+                    else if(length < 0 && errno != EAGAIN && errno != EINTR)
+                        dead = true;
+                    if(worker.out_offset == worker.out.size())
+                    {
+                        worker.out.clear();
+                        worker.out_offset = 0;
+                    }
+                }
+                if(fds[k].revents & (POLLIN | POLLHUP | POLLERR))
+                {
+                    char buffer[1 << 16];
+                    ssize_t length = recv(worker.fd, buffer, sizeof(buffer), 0);
+                    if(length > 0)
+                        worker.in.append(buffer, length);
+                    else if(length == 0 || (errno != EAGAIN && errno != EINTR))
+                        dead = true;
+                }
+                // answers that did arrive are kept even if the worker died right after
+                size_t offset = 0;
+                while(worker.in.size() - offset >= 4 + RESPONSE_SIZE)
+                {
+                    Response response;
+                    if(frameLength(worker.in.data() + offset) != RESPONSE_SIZE ||
+                        !decodeResponse(worker.in.data() + offset + 4, RESPONSE_SIZE, response) ||
+                        worker.shard < 0 || response.id < shards[worker.shard].begin ||
+                        response.id >= shards[worker.shard].end)
+                    {
+                        dead = true;
+                        break;
+                    }
+                    offset += 4 + RESPONSE_SIZE;
+                    if(done[response.id])
+                        continue;
+                    done[response.id] = 1;
+                    results[response.id] = response;
+                    ++worker.puzzles;
+                    Shard& shard = shards[worker.shard];
+                    if(--shard.remaining == 0)
+                    {
+                        ++worker.shards;
+                        ++finished;
+                        worker.busy_us += nowUs() - worker.started_us;
+                        worker.shard = -1;
+                    }
+                }
+                worker.in.erase(0, offset);
+                if(dead)
+                {
+                    if(worker.shard >= 0)
+                    {
+                        worker.busy_us += nowUs() - worker.started_us;
+                        ++m_retry_num;
+                        if(shards[worker.shard].attempts >= m_config.max_attempts)
+                            giveUp(worker.shard);
+                        else
+                            queue.push_front(worker.shard);
+                    }
+                    reap(worker);
+                    if(spawn_budget > 0)
+                    {
+                        --spawn_budget;
+                        ++worker.restarts;
+                        spawn(worker);
+                    }
+                }
+            }
+            while(next_ready < puzzles.size() && done[next_ready])
+            {
+                if(ready)
+                    ready(next_ready);
+                ++next_ready;
+            }
+        }
+        while(next_ready < puzzles.size() && done[next_ready])
+        {
+            if(ready)
+                ready(next_ready);
+            ++next_ready;
+        }
+        m_elapsed_us += nowUs() - tic;
+        m_puzzle_num += puzzles.size();
+        return complete;
+    }
+
+    void Coordinator::report(std::ostream& os)
+    {
+        os << m_puzzle_num << " puzzles over " << m_workers.size() << " workers in " << m_elapsed_us << " us";
+        if(m_elapsed_us > 0)
+            os << " (" << m_puzzle_num / m_elapsed_us * 1e6 << " puzzles/s)";
+        os << ", " << m_retry_num << " shard retries, " << m_failed_shard_num << " shards given up\n";
+        double max_busy = 0, total_busy = 0;
+        for(size_t i=0; i<m_workers.size(); ++i)
+        {
+            const Worker& worker = m_workers[i];
+            os << "  worker " << i << ": " << worker.shards << " shards, " << worker.puzzles << " puzzles, busy "
+                << worker.busy_us << " us, " << worker.restarts << " restarts\n";
+            max_busy = std::max(max_busy, worker.busy_us);
+            total_busy += worker.busy_us;
+        }
+        // 1.0 means perfectly even, the slowest worker bounds the wall time
+        if(total_busy > 0)
+            os << "  skew (max/mean busy): " << max_busy / (total_busy / m_workers.size()) << "\n";
+    }
+
+    int runShardWorker(int in_fd, int out_fd, const Options& options)
+    {
+        std::string in, out;
+        char buffer[1 << 16];
+        while(true)
+        {
+            ssize_t length = read(in_fd, buffer, sizeof(buffer));
+            if(length < 0 && errno == EINTR)
+                continue;
+            if(length <= 0)
+                return length == 0? 0: -1;
+            in.append(buffer, length);
+            size_t offset = 0;
+            while(in.size() - offset >= 4)
+            {
+                uint32_t size = frameLength(in.data() + offset);
+                if(size != REQUEST_SIZE)
+                    return -1;
+                if(in.size() - offset - 4 < size)
+                    break;
+                Request request;
+                decodeRequest(in.data() + offset + 4, size, request);
+                offset += 4 + size;
+                Response response;
+                Stats stats;
+                response.id = request.id;
+                response.status = solve(request.grid, response.solution, options, &stats);
+                response.iters = stats.iters;
+                response.guesses = stats.guesses;
+                response.backtraces = stats.backtraces;
+                response.elapsed_us = stats.elapsed_us;
+                encodeResponse(response, out);
+            }
+            in.erase(0, offset);
+            // one write per chunk read keeps the answers flowing without a syscall per puzzle
+            if(!writeAll(out_fd, out))
+                return -1;
+            out.clear();
+        }
+    }
+}
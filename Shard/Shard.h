@@ -0,0 +1,80 @@
+#ifndef _SHARD_H
+#define _SHARD_H
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "Server/Server.h"
+
+namespace Sudoku
+{
+    struct ShardConfig
+    {
+        unsigned int workers;
+        unsigned int shard_size;            // puzzles per shard
+        unsigned int max_attempts;          // a shard whose workers died this often is given up
+        std::vector<std::string> command;   // worker program and arguments, talks on stdin/stdout
+
+        ShardConfig():
+            workers(1),
+            shard_size(256),
+            max_attempts(3)
+        {}
+    };
+
+    /*
+     * Splits a corpus into contiguous shards and feeds them to worker
+     * processes over socket pairs, one shard in flight per worker. Workers
+     * speak the frame protocol of Server/Server.h, so a worker on another
+     * host only needs a different transport. A dead worker is replaced and
+     * the unanswered puzzles of its shard are queued again.
+     */
+    class Coordinator
+    {
+    public:
+        Coordinator(const ShardConfig& config);
+        ~Coordinator();
+        // results[i] answers puzzles[i], ready(i) is called in input order as soon as results up to i are in;
+        // false if some shard was given up (its results have status Cancelled)
+        bool run(const std::vector<Grid>& puzzles, std::vector<Response>& results,
+            std::function<void(size_t)> ready=nullptr);
+        void report(std::ostream& os);
+    private:
+        struct Worker
+        {
+            pid_t pid;
+            int fd;
+            int shard;          // -1 while idle
+            std::string in;
+            std::string out;
+            size_t out_offset;
+            double started_us;
+            // accumulated over every process that held this slot
+            unsigned int shards;
+            unsigned long puzzles;
+            double busy_us;
+            unsigned int restarts;
+        };
+        struct Shard
+        {
+            size_t begin;
+            size_t end;
+            size_t remaining;
+            unsigned int attempts;
+        };
+        bool spawn(Worker& worker);
+        void reap(Worker& worker);
+        ShardConfig m_config;
+        std::vector<Worker> m_workers;
+        double m_elapsed_us;
+        unsigned long m_puzzle_num;
+        unsigned int m_retry_num;
+        unsigned int m_failed_shard_num;
+    };
+
+    // worker side: answers request frames from in_fd on out_fd until EOF
+    int runShardWorker(int in_fd, int out_fd, const Options& options);
+};
+#endif
@@ -0,0 +1,101 @@
+#ifndef _OPTIONS_H
+#define _OPTIONS_H
+
+#include <atomic>
+
+namespace Sudoku
+{
+    enum class Status {
+        Solved,
+        Invalid,
+        Unsolvable,
+        IterLimit,
+        TimedOut,
+        Cancelled
+    };
+
+    inline const char* toString(Status status)
+    {
+        switch(status)
+        {
+            case Status::Solved:
+                return "solved";
+            case Status::Invalid:
+                return "invalid puzzle";
+            case Status::Unsolvable:
+                return "unsolvable";
+            case Status::IterLimit:
+                return "iteration limit reached";
+            case Status::TimedOut:
+                return "timed out";
+            case Status::Cancelled:
+                return "cancelled";
+        }
+        return "unknown";
+    }
+
+    // how guess() picks the cell to branch on
+    enum class Branching {
+        Pair,       // cells sharing two aux numbers first, then the fewest candidates
+        Fewest,     // first cell with the fewest candidates
+        Random      // random cell among the ones with the fewest candidates
+    };
+
+    inline const char* toString(Branching branching)
+    {
+        switch(branching)
+        {
+            case Branching::Pair:
+                return "pair";
+            case Branching::Fewest:
+                return "fewest";
+            case Branching::Random:
+                return "random";
+        }
+        return "unknown";
+    }
+
+    enum class Engine {
+        Propagation,    // Solver: rule based propagation with guess/backtrace
+        Cdcl            // CdclSolver: clause learning over the CNF encoding
+    };
+
+    inline const char* toString(Engine engine)
+    {
+        return engine == Engine::Cdcl? "cdcl": "propagation";
+    }
+
+    struct Options
+    {
+        Engine engine;
+        unsigned int max_iters;             // 0: no limit (conflicts for the CDCL engine)
+        long long time_limit_us;            // wall-clock budget, 0: no limit
+        const std::atomic<bool>* cancel;    // set to true from another thread to stop the search
+        bool show_status;
+        Branching branching;
+        unsigned int seed;                  // shuffles the order candidates are guessed in, 0: ascending
+        unsigned int probe_budget;          // bi-value cells probed before each guess, 0: no probing
+        unsigned int probe_depth;           // single/hidden single rounds run per probe
+        bool perf_counters;                 // hardware counters per solve and phase, see Perf/Perf.h
+        const char* state_file;             // search state is saved here between iterations, nullptr: never
+        long long checkpoint_interval_us;   // minimum wall-clock time between two saves
+        bool resume;                        // start from state_file when it was saved for the same givens
+
+        Options():
+            engine(Engine::Propagation),
+            max_iters(0),
+            time_limit_us(0),
+            cancel(nullptr),
+            show_status(false),
+            branching(Branching::Pair),
+            seed(0),
+            probe_budget(0),
+            probe_depth(4),
+            perf_counters(false),
+            state_file(nullptr),
+            checkpoint_interval_us(10000000),
+            resume(false)
+        {}
+    };
+};
+#endif
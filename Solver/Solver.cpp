@@ -1,9 +1,8 @@
 #include <sstream>
+#include <fstream>
+#include <cstdio>
 #include <cassert>
 #include <algorithm>
-#ifdef OPENMP
-#include <omp.h>
-#endif
 #include "Solver.h"
 #include "Utilities/Utilities.h"
 
@@ -14,21 +13,53 @@ namespace Sudoku
         :Problem(filename),
         m_iter(0),
         m_guess_num(0),
-        m_backtrace_num(0)
+        m_backtrace_num(0),
+        m_probe_elimination_num(0),
+        m_status(Status::IterLimit),
+        m_trace_rule(TraceRule::None),
+        m_phase(Phase::Setup),
+        m_resumed(false)
     {
-        auto tic = std::chrono::system_clock::now();
-        auto coords = getUnsolved();
-        #ifdef OPENMP
-        #pragma omp parallel for
-        #endif
-        for(size_t i=0; i<coords.size(); ++i)
+        initAux();
+    }
+
+    Solver::Solver(const uint8_t grid[SIZE * SIZE], const std::vector<Cage>& cages, const Regions& regions)
+        :Problem(grid, cages, regions),
+        m_iter(0),
+        m_guess_num(0),
+        m_backtrace_num(0),
+        m_probe_elimination_num(0),
+        m_status(Status::IterLimit),
+        m_trace_rule(TraceRule::None),
+        m_phase(Phase::Setup),
+        m_resumed(false)
+    {
+        initAux();
+    }
+
+    void Solver::initAux(void)
+    {
+        // candidates come from the unit masks built while loading the givens,
+        // the per-cell lists are only materialized once the engine needs them
+        // (all at once: the first iteration scans every open cell for singles,
+        // and a cell missing from m_aux means solved to every rule)
+        m_aux.clear();
+        m_aux_ready = false;
+        for(int cell=0; cell<SIZE * SIZE; ++cell)
+            m_givens[cell] = getCell(Coord(cell / SIZE, cell % SIZE));
+    }
+
+    void Solver::ensureAux(void)
+    {
+        if(m_aux_ready)
+            return;
+        auto tic = std::chrono::steady_clock::now();
+        for(auto coord: getUnsolved())
         {
-            Coord coord = coords[i];
-            #ifdef OPENMP
-            std::lock_guard<std::mutex> guard(m_mutex);
-            #endif
-            generateAux(coord);
+            if(m_aux.find(coord) == m_aux.end())
+                generateAux(coord);
         }
+        m_aux_ready = true;
         #ifdef VERBOSE
         std::cout << "[Solver] generateAux: " << getTimeDiff(tic) << " us\n";
         #endif
@@ -40,9 +71,6 @@ namespace Sudoku
         if(!m_guessed.empty() && value != 0 && add_in_stack)
         {
             Node node = Node(coord, Aux{}, std::vector<std::pair<Coord, Coord>>());
-            #ifdef VERBOSE
-            std::cout << "Stack add node " << &node << "\n";
-            #endif
             m_guessed.push(node);
         }
         /*
@@ -51,8 +79,15 @@ namespace Sudoku
          */
         if(value != 0)
         {
+            trace(TraceType::Set, coord, value);
+            m_trace_rule = TraceRule::Peer;
             removeAux(coord, {value});
             updateStatus(coord);
+            if(getCageId(coord) >= 0)
+            {
+                removeSameCageAux(coord, {value});
+                pruneCage(getCageId(coord));
+            }
         }
     }
 
@@ -62,19 +97,12 @@ namespace Sudoku
         {
             throw std::runtime_error("Cell already occupied");
         }
-        unsigned int row = coord.first, column = coord.second;
-        std::array<int, 9> row_content = getRow(row);
-        std::array<int, 9> col_content = getColumn(column);
-        std::array<int, 9> block_content = flattenBlock(getBlock(computeBlockId(coord)));
+        uint16_t mask = getCandidateMask(coord);
         std::vector<int> aux_values;
         for(int i=1; i<=9; ++i)
         {
-            if(!valueInside(row_content, i) &&
-               !valueInside(col_content, i) &&
-               !valueInside(block_content, i))
-            {
+            if(mask & (1 << i))
                 aux_values.push_back(i);
-            }
         }
         m_aux[coord] = aux_values;
     }
@@ -95,10 +123,8 @@ namespace Sudoku
                 {
                     std::vector<int>& aux = m_aux[same_row];
                     bool removed = eraseValue(aux, value);
-                    #ifdef VERBOSE
                     if(removed)
-                        std::cout << "[Row] " << same_row << " remove " << value << "\n";
-                    #endif
+                        trace(TraceType::Eliminate, same_row, value);
                     if(aux.size() == 0)
                     {
                         std::stringstream ss;
@@ -126,10 +152,8 @@ namespace Sudoku
                 {
                     std::vector<int>& aux = m_aux[same_col];
                     bool removed = eraseValue(aux, value);
-                    #ifdef VERBOSE
                     if(removed)
-                        std::cout << "[Column] " << same_col << " remove " << value << "\n";
-                    #endif
+                        trace(TraceType::Eliminate, same_col, value);
                     if(aux.size() == 0)
                     {
                         std::stringstream ss;
@@ -145,7 +169,7 @@ namespace Sudoku
     {
         for(auto value: values)
         {
-            for(auto _coord: getBlockCoords(computeBlockId(coord)))
+            for(auto _coord: getBlockCoords(coord))
             {
                 if(_coord == coord)
                     continue;
@@ -155,10 +179,8 @@ namespace Sudoku
                 {
                     std::vector<int>& aux = m_aux[_coord];
                     bool removed = eraseValue(aux, value);
-                    #ifdef VERBOSE
                     if(removed)
-                        std::cout << "[Block] " << _coord << " remove " << value << "\n";
-                    #endif
+                        trace(TraceType::Eliminate, _coord, value);
                     if(aux.size() == 0)
                     {
                         std::stringstream ss;
@@ -170,6 +192,131 @@ namespace Sudoku
         }
     }
 
+    void Solver::removeSameCageAux(Coord coord, std::vector<int> values)
+    {
+        int cage_id = getCageId(coord);
+        if(cage_id < 0)
+            return;
+        for(auto value: values)
+        {
+            for(auto _coord: getCage(cage_id).cells)
+            {
+                if(_coord == coord)
+                    continue;
+                if(m_aux.find(_coord) != m_aux.end())
+                {
+                    std::vector<int>& aux = m_aux[_coord];
+                    bool removed = eraseValue(aux, value);
+                    if(removed)
+                        trace(TraceType::Eliminate, _coord, value);
+                    if(aux.size() == 0)
+                    {
+                        std::stringstream ss;
+                        ss << _coord << " without any auxiliary number";
+                        throw std::runtime_error(ss.str());
+                    }
+                }
+            }
+        }
+    }
+
+    bool Solver::pruneCage(unsigned int cage_id, bool place_single)
+    {
+        if(!m_aux_ready)
+            return false;
+        const Cage& cage = getCage(cage_id);
+        uint16_t placed = getCageMask(cage_id);
+        unsigned int remaining = cage.cells.size() - maskCount(placed);
+        if(remaining == 0)
+            return false;
+        // candidate masks of the open cells of the cage
+        std::array<std::pair<Coord, uint16_t>, SIZE> open;
+        unsigned int open_num = 0;
+        uint16_t open_union = 0;
+        for(auto coord: cage.cells)
+        {
+            auto it = m_aux.find(coord);
+            if(it == m_aux.end())
+                continue;
+            uint16_t mask = 0;
+            for(auto value: it->second)
+                mask |= 1 << value;
+            open[open_num++] = std::make_pair(coord, mask);
+            open_union |= mask;
+        }
+        // a digit set is still possible if it avoids the placed values and every open cell can take one of it
+        uint16_t allowed = 0, required = FULL_MASK;
+        for(auto combination: cageCombinations(remaining, cage.sum - maskSum(placed)))
+        {
+            if((combination & placed) || (combination & open_union) != combination)
+                continue;
+            bool coverable = true;
+            for(unsigned int i=0; i<open_num && coverable; ++i)
+                coverable = (open[i].second & combination) != 0;
+            if(!coverable)
+                continue;
+            allowed |= combination;
+            required &= combination;
+        }
+        if(allowed == 0)
+        {
+            std::stringstream ss;
+            ss << "Cage " << cage_id << " without any valid combination";
+            throw std::runtime_error(ss.str());
+        }
+        bool changed = false;
+        for(unsigned int i=0; i<open_num; ++i)
+        {
+            uint16_t removed = open[i].second & ~allowed;
+            if(removed == 0)
+                continue;
+            std::vector<int>& aux = m_aux[open[i].first];
+            m_trace_rule = TraceRule::Cage;
+            for(int value=1; value<=9; ++value)
+            {
+                if(removed & (1 << value))
+                {
+                    eraseValue(aux, value);
+                    trace(TraceType::Eliminate, open[i].first, value);
+                }
+            }
+            if(aux.size() == 0)
+            {
+                std::stringstream ss;
+                ss << open[i].first << " without any auxiliary number";
+                throw std::runtime_error(ss.str());
+            }
+            open[i].second &= allowed;
+            changed = true;
+        }
+        if(!place_single)
+            return changed;
+        // a digit every combination needs, with a single cell left to hold it
+        for(int value=1; value<=9; ++value)
+        {
+            if(!(required & (1 << value)))
+                continue;
+            int count = 0;
+            Coord coord;
+            for(unsigned int i=0; i<open_num; ++i)
+            {
+                if(open[i].second & (1 << value))
+                {
+                    ++count;
+                    coord = open[i].first;
+                }
+            }
+            if(count == 1 && m_aux.find(coord) != m_aux.end() && m_aux[coord].size() > 1)
+            {
+                m_aux.erase(coord);
+                m_trace_rule = TraceRule::Cage;
+                setCell(coord, value);
+                return true;
+            }
+        }
+        return changed;
+    }
+
     void Solver::removeAux(Coord coord, std::vector<int> values, std::vector<Coord> excluded_coords)
     {
         removeSameRowAux(coord, values, excluded_coords);
@@ -177,13 +324,39 @@ namespace Sudoku
         removeSameBlockAux(coord, values, excluded_coords);
     }
 
-    void Solver::solve(bool show_status)
+    Status Solver::solve(const Options& options)
     {
+        m_options = options;
+        m_status = Status::IterLimit;
+        m_rng.seed(m_options.seed);
+        if(m_options.perf_counters)
+            m_perf_mark = PerfCounters::thread().read();
+        m_phase = Phase::Setup;
+        m_resumed = m_options.resume && m_options.state_file != nullptr && loadStateFile(m_options.state_file);
+        ensureAux();
+        if(m_options.time_limit_us > 0)
+        {
+            m_deadline = std::chrono::steady_clock::now() +
+                std::chrono::microseconds(m_options.time_limit_us);
+        }
+        m_next_checkpoint = std::chrono::steady_clock::now() +
+            std::chrono::microseconds(m_options.checkpoint_interval_us);
+        traceEvent(TraceType::Begin, 255, SIZE * SIZE - getUnsolved().size(), TraceRule::None, 0);
         bool is_block = false;
         while(!is_block && !getSolved())
         {
+            if(interrupted())
+                break;
+            // between iterations the candidates and the stack agree, a safe point to save
+            if(m_options.state_file != nullptr && std::chrono::steady_clock::now() >= m_next_checkpoint)
+            {
+                saveStateFile(m_options.state_file);
+                m_next_checkpoint = std::chrono::steady_clock::now() +
+                    std::chrono::microseconds(m_options.checkpoint_interval_us);
+            }
             is_block = true;
             ++m_iter;
+            enterPhase(Phase::Propagate);
             try
             {
                 for(auto it=m_aux.begin(); it!=m_aux.end(); )
@@ -193,11 +366,8 @@ namespace Sudoku
                         is_block = false;
                         Coord coord = it->first;
                         int value = it->second[0];
-                        #ifdef VERBOSE
-                        std::cout << "Set " << it->first << " to " << value
-                            << " (Only one aux)\n";
-                        #endif
                         it = m_aux.erase(it);
+                        m_trace_rule = TraceRule::Single;
                         setCell(coord, value);
                     }
                     else if(it->second.size() == 2)  // same row/column/block share two aux numbers
@@ -218,11 +388,8 @@ namespace Sudoku
                             {
                                 if(m_aux[Coord(_row, column)] == it->second)
                                 {
-                                    #ifdef VERBOSE
-                                    std::cout << it->first << " shares same 2 aux numbers with "
-                                        << Coord(_row, column) << " (same column)\n";
-                                    #endif
                                     m_common_aux.push_back(std::make_pair(it->first, Coord(_row, column)));
+                                    m_trace_rule = TraceRule::Pair;
                                     removeSameColumnAux(it->first, it->second, {it->first, Coord(_row, column)});
                                     if(coordInside(getBlockCoords(it->first), Coord(_row, column)))  // same block
                                     {
@@ -242,11 +409,8 @@ namespace Sudoku
                             {
                                 if(m_aux[Coord(row, _col)] == it->second && !isRecordedCell(Coord(row, _col)))
                                 {
-                                    #ifdef VERBOSE
-                                    std::cout << it->first << " shares same 2 aux numbers with "
-                                        << Coord(row, _col) << " (same row)\n";
-                                    #endif
                                     m_common_aux.push_back(std::make_pair(it->first, Coord(row, _col)));
+                                    m_trace_rule = TraceRule::Pair;
                                     removeSameRowAux(it->first, it->second, {it->first, Coord(row, _col)});
                                     if(coordInside(getBlockCoords(it->first), Coord(row, _col)))  // same block
                                     {
@@ -257,7 +421,7 @@ namespace Sudoku
                             }
                         }
                         // same block
-                        std::vector<Coord> coords = getBlockCoords(it->first);
+                        const std::vector<Coord>& coords = getBlockCoords(it->first);
                         for(auto coord: coords)
                         {
                             if(coord == it->first)
@@ -267,11 +431,8 @@ namespace Sudoku
                             {
                                 if(m_aux[coord] == it->second && !isRecordedCell(coord))
                                 {
-                                    #ifdef VERBOSE
-                                    std::cout << it->first << " shares same 2 aux numbers with "
-                                        << coord << " (same block)\n";
-                                    #endif
                                     m_common_aux.push_back(std::make_pair(it->first, coord));
+                                    m_trace_rule = TraceRule::Pair;
                                     removeSameBlockAux(it->first, it->second, {it->first, coord});
                                     is_block = false;
                                 }
@@ -284,6 +445,12 @@ namespace Sudoku
                         ++it;
                     }
                 }
+                // cage sums restrict the open cells to digits of the remaining combinations
+                for(unsigned int cage_id = 0; cage_id<getCageNum(); ++cage_id)
+                {
+                    if(pruneCage(cage_id, true))
+                        is_block = false;
+                }
                 // aux number only appear in one cell of row/column/block
                 for(int row=0; row<SIZE; ++row)
                 {
@@ -295,10 +462,7 @@ namespace Sudoku
                     {
                         if(pair.second.first != 1)
                             continue;
-                        #ifdef VERBOSE
-                        std::cout << "Set " << pair.second.second << " to " << pair.first
-                            << " (One aux in row)\n";
-                        #endif
+                        m_trace_rule = TraceRule::HiddenRow;
                         setCell(pair.second.second, pair.first);
                         is_block = false;
                     }
@@ -313,10 +477,7 @@ namespace Sudoku
                     {
                         if(pair.second.first != 1)
                             continue;
-                        #ifdef VERBOSE
-                        std::cout << "Set " << pair.second.second << " to " << pair.first
-                            << " (One aux in column)\n";
-                        #endif
+                        m_trace_rule = TraceRule::HiddenColumn;
                         setCell(pair.second.second, pair.first);
                         is_block = false;
                     }
@@ -331,17 +492,14 @@ namespace Sudoku
                     {
                         if(pair.second.first == 1)
                         {
-                            #ifdef VERBOSE
-                            std::cout << "Set " << pair.second.second << " to " << pair.first
-                                << " (One aux in block)\n";
-                            #endif
+                            m_trace_rule = TraceRule::HiddenBlock;
                             setCell(pair.second.second, pair.first);
                             is_block = false;
                         }
                         else if(pair.second.first <= 3)
                         {
                             std::vector<Coord> coords;
-                            std::vector<Coord> block_coords = getBlockCoords(block_id);
+                            const std::vector<Coord>& block_coords = getBlockCoords(block_id);
                             for(auto coord: block_coords)
                             {
                                 if(m_aux.find(coord) == m_aux.end())
@@ -349,62 +507,121 @@ namespace Sudoku
                                 if(valueInside(m_aux[coord], pair.first))
                                     coords.push_back(coord);
                             }
+                            // placed by an earlier entry of this (now stale) map
+                            if(coords.empty())
+                                continue;
                             unsigned int row = coords[0].first, column = coords[0].second;
+                            m_trace_rule = TraceRule::Pointing;
                             if(std::all_of(coords.begin(), coords.end(), [row](const Coord& c)
                                 {return c.first == row;}))
                             {
-                                #ifdef VERBOSE
-                                std::cout << "Row " << row << ": " << pair.first << " must appear in block "
-                                    << block_id << "\n";
-                                #endif
                                 removeSameRowAux(coords[0], {pair.first}, coords);
                             }
                             if(std::all_of(coords.begin(), coords.end(), [column](const Coord& c)
                                 {return c.second == column;}))
                             {
-                                #ifdef VERBOSE
-                                std::cout << "Column " << column << " " << pair.first << " must appear in block "
-                                    << block_id << "\n";
-                                #endif
                                 removeSameColumnAux(coords[0], {pair.first}, coords);
                             }
                         }
                     }
                 }
             }
-            catch(const std::exception& e)
+            catch(const std::exception&)
             {
-                #ifdef VERBOSE
-                std::cout << "Exception: " << e.what() << "\n";
-                #endif
-                if(m_guess_num == 0)
+                traceEvent(TraceType::Contradiction, 255, 0, m_trace_rule, m_iter);
+                enterPhase(Phase::Search);
+                if(!recover())
                 {
-                    std::cerr << "The quiz may be problematic, please check!\n";
-                    exit(-1);
+                    m_status = Status::Unsolvable;
+                    enterPhase(m_phase);
+                    return m_status;
                 }
-                backtrace();
-                #ifdef VERBOSE
-                std::cout << "After backtrace, stack top set to " << &m_guessed.top() << "\n";
-                #endif
-                int guessed_number = m_guessed.top().getGuessedNumber();
-                setCell(m_guessed.top().coord, guessed_number, false);
             }
-            if(show_status)
+            if(m_options.show_status)
                 showStatus();
             if(is_block && !getSolved())
             {
-                guess();
+                if(interrupted())
+                    break;
+                try
+                {
+                    enterPhase(Phase::Probe);
+                    bool probed = m_options.probe_budget != 0 && probe();
+                    enterPhase(Phase::Search);
+                    if(!probed)
+                        guess();
+                }
+                catch(const std::exception&)
+                {
+                    traceEvent(TraceType::Contradiction, 255, 0, m_trace_rule, m_iter);
+                    enterPhase(Phase::Search);
+                    if(!recover())
+                    {
+                        m_status = Status::Unsolvable;
+                        enterPhase(m_phase);
+                        return m_status;
+                    }
+                }
                 is_block = false;
             }
-            #ifdef MAX_ITERS
-            if(m_iter==MAX_ITERS)
+            if(m_options.max_iters != 0 && m_iter >= static_cast<int>(m_options.max_iters))
                 break;
-            #endif
         }
+        if(getSolved())
+            m_status = Status::Solved;
+        enterPhase(m_phase);
+        return m_status;
+    }
+
+    void Solver::enterPhase(Phase phase)
+    {
+        if(!m_options.perf_counters)
+            return;
+        PerfSample now = PerfCounters::thread().read();
+        m_phase_perf[static_cast<int>(m_phase)].add(now - m_perf_mark);
+        m_perf_mark = now;
+        m_phase = phase;
+    }
+
+    bool Solver::recover(void)
+    {
+        // the next candidate of the restored node may fail immediately, keep unwinding
+        while(backtrace())
+        {
+            try
+            {
+                int guessed_number = m_guessed.top().getGuessedNumber();
+                m_trace_rule = TraceRule::Guess;
+                trace(TraceType::Guess, m_guessed.top().coord, guessed_number);
+                setCell(m_guessed.top().coord, guessed_number, false);
+                return true;
+            }
+            catch(const std::exception&)
+            {
+                traceEvent(TraceType::Contradiction, 255, 0, m_trace_rule, m_iter);
+            }
+        }
+        return false;
+    }
+
+    bool Solver::interrupted(void)
+    {
+        if(m_options.cancel != nullptr && m_options.cancel->load(std::memory_order_relaxed))
+        {
+            m_status = Status::Cancelled;
+            return true;
+        }
+        if(m_options.time_limit_us > 0 && std::chrono::steady_clock::now() >= m_deadline)
+        {
+            m_status = Status::TimedOut;
+            return true;
+        }
+        return false;
     }
 
     void Solver::displayAux(void)
     {
+        ensureAux();
         for(auto pair: m_aux)
         {
             std::cout << pair.first << ": " << pair.second << "\n";
@@ -543,7 +760,7 @@ namespace Sudoku
     FrequencyMap Solver::countSameBlockAuxFreqMap(unsigned int block_id)
     {
         FrequencyMap freqMap;
-        std::vector<Coord> coords = getBlockCoords(block_id);
+        const std::vector<Coord>& coords = getBlockCoords(block_id);
         for(auto coord: coords)
         {
             if(m_aux.find(coord) == m_aux.end())
@@ -590,57 +807,200 @@ namespace Sudoku
         }
     }
 
+    namespace
+    {
+        /*
+         * Place value in cell and run up to rounds of single / hidden single
+         * rounds over the masks, false on contradiction. A placed cell keeps
+         * the bit of its value so both branches of a probe can be merged.
+         */
+        bool propagateProbe(const Regions& regions, uint16_t candidates[SIZE * SIZE], bool placed[SIZE * SIZE],
+            int cell, int value, unsigned int rounds)
+        {
+            std::vector<std::pair<int, int>> queue(1, std::make_pair(cell, value));
+            for(unsigned int round=0; round<rounds && !queue.empty(); ++round)
+            {
+                while(!queue.empty())
+                {
+                    int _cell = queue.back().first;
+                    uint16_t bit = 1 << queue.back().second;
+                    queue.pop_back();
+                    if(placed[_cell])
+                    {
+                        if(candidates[_cell] != bit)
+                            return false;
+                        continue;
+                    }
+                    if(!(candidates[_cell] & bit))
+                        return false;
+                    placed[_cell] = true;
+                    candidates[_cell] = bit;
+                    for(auto peer: regions.getPeers(_cell))
+                    {
+                        if(placed[peer])
+                            continue;
+                        candidates[peer] &= ~bit;
+                        if(candidates[peer] == 0)
+                            return false;
+                    }
+                }
+                for(int _cell=0; _cell<SIZE * SIZE; ++_cell)
+                {
+                    uint16_t mask = candidates[_cell];
+                    if(!placed[_cell] && (mask & (mask - 1)) == 0)
+                        queue.push_back(std::make_pair(_cell, __builtin_ctz(mask)));
+                }
+                for(auto& unit: regions.getUnits())
+                {
+                    uint16_t once = 0, twice = 0, all = 0;
+                    for(auto _cell: unit)
+                    {
+                        all |= candidates[_cell];
+                        if(placed[_cell])
+                            continue;
+                        twice |= once & candidates[_cell];
+                        once |= candidates[_cell];
+                    }
+                    if(all != FULL_MASK)
+                        return false;
+                    uint16_t singles = once & ~twice;
+                    for(auto _cell: unit)
+                    {
+                        if(!placed[_cell] && (candidates[_cell] & singles))
+                            queue.push_back(std::make_pair(_cell, __builtin_ctz(candidates[_cell] & singles)));
+                    }
+                }
+            }
+            return true;
+        }
+    }
+
+    bool Solver::probe(void)
+    {
+        uint16_t candidates[SIZE * SIZE];
+        bool placed[SIZE * SIZE];
+        for(int cell=0; cell<SIZE * SIZE; ++cell)
+        {
+            int value = getCell(Coord(cell / SIZE, cell % SIZE));
+            candidates[cell] = value == 0? 0: 1 << value;
+            placed[cell] = value != 0;
+        }
+        for(auto& pair: m_aux)
+        {
+            uint16_t mask = 0;
+            for(auto value: pair.second)
+                mask |= 1 << value;
+            candidates[pair.first.first * SIZE + pair.first.second] = mask;
+        }
+        unsigned int probed = 0;
+        for(auto& pair: m_aux)
+        {
+            if(pair.second.size() != 2)
+                continue;
+            if(probed++ == m_options.probe_budget)
+                break;
+            int cell = pair.first.first * SIZE + pair.first.second;
+            // a value survives if one of the two branches still allows it
+            uint16_t allowed[SIZE * SIZE];
+            bool consistent = false;
+            std::fill(allowed, allowed + SIZE * SIZE, 0);
+            for(auto value: pair.second)
+            {
+                uint16_t branch[SIZE * SIZE];
+                bool branch_placed[SIZE * SIZE];
+                std::copy(candidates, candidates + SIZE * SIZE, branch);
+                std::copy(placed, placed + SIZE * SIZE, branch_placed);
+                if(!propagateProbe(getRegions(), branch, branch_placed, cell, value, m_options.probe_depth))
+                    continue;
+                consistent = true;
+                for(int i=0; i<SIZE * SIZE; ++i)
+                    allowed[i] |= branch[i];
+            }
+            if(!consistent)
+            {
+                std::stringstream ss;
+                ss << pair.first << " fails with both auxiliary numbers";
+                throw std::runtime_error(ss.str());
+            }
+            int eliminated = 0;
+            for(auto& _pair: m_aux)
+            {
+                int _cell = _pair.first.first * SIZE + _pair.first.second;
+                uint16_t removed = candidates[_cell] & ~allowed[_cell];
+                if(removed == 0)
+                    continue;
+                for(int value=1; value<=SIZE; ++value)
+                {
+                    if(removed & (1 << value))
+                    {
+                        eraseValue(_pair.second, value);
+                        m_trace_rule = TraceRule::Probe;
+                        trace(TraceType::Eliminate, _pair.first, value);
+                        ++eliminated;
+                    }
+                }
+            }
+            if(eliminated != 0)
+            {
+                m_probe_elimination_num += eliminated;
+                return true;
+            }
+        }
+        return false;
+    }
+
     void Solver::guess(void)
     {
-        #ifdef VERBOSE
-        std::cout << "Stuck after " << m_iter << " iterations, starts guessing...\n";
-        #endif
         ++m_guess_num;
         Coord coord;
-        if(m_common_aux.size() != 0)
+        if(m_options.branching == Branching::Pair && m_common_aux.size() != 0)
         {
             coord = m_common_aux[0].first;
         }
         else
         {
-            int cnt = 2;
-            bool found = false;
-            while(!found)
+            size_t fewest = SIZE + 1;
+            unsigned int ties = 0;
+            for(auto& pair: m_aux)
             {
-                for(auto pair: m_aux)
+                size_t cnt = pair.second.size();
+                if(cnt < 2 || cnt > fewest)
+                    continue;
+                if(cnt < fewest)
                 {
-                    if(pair.second.size() == cnt)
-                    {
-                        coord = pair.first;
-                        found = true;
-                        break;
-                    }
+                    fewest = cnt;
+                    coord = pair.first;
+                    ties = 1;
+                }
+                else if(m_options.branching == Branching::Random && m_rng() % ++ties == 0)
+                {
+                    // reservoir sampling over the cells with the fewest candidates
+                    coord = pair.first;
                 }
-                ++cnt;
             }
+            if(fewest > SIZE)
+                throw std::runtime_error("No cell left to guess");
         }
         Node node = Node(coord, m_aux, m_common_aux);
-        m_guessed.push(node);
-        #ifdef VERBOSE
-        std::cout << "Stack add node " << &node << "\n";
-        #endif
+        if(m_options.seed != 0)
+            std::shuffle(node.candidates.begin(), node.candidates.end(), m_rng);
         int guessed_number = node.getGuessedNumber();
+        m_guessed.push(node);
+        m_trace_rule = TraceRule::Guess;
+        trace(TraceType::Guess, coord, guessed_number);
         setCell(coord, guessed_number, false);
     }
 
-    void Solver::backtrace(void)
+    bool Solver::backtrace(void)
     {
+        if(m_guessed.empty())
+            return false;
         ++m_backtrace_num;
-        #ifdef VERBOSE
-        std::cout << "Incorrect assumption, start recovering from " << &m_guessed.top() << " ...\n";
-        #endif
+        int popped = 0;
         while(!m_guessed.empty())
         {
             Node node = m_guessed.top();
             setCell(node.coord, 0);
-            #ifdef VERBOSE
-            std::cout << "[Backtrace] " << node.coord << " reset to 0\n";
-            #endif
             if(node.candidates.size() != 0)
             {
                 bool allGuessed = node.getAllGuessed();
@@ -650,12 +1010,241 @@ namespace Sudoku
                 }
             }
             m_guessed.pop();
+            ++popped;
         }
+        traceEvent(TraceType::Backtrace, m_guessed.empty()? 255:
+            m_guessed.top().coord.first * SIZE + m_guessed.top().coord.second,
+            std::min(popped, 255), TraceRule::None, m_iter);
+        if(m_guessed.empty())
+            return false;
         m_aux = m_guessed.top().aux;
         m_common_aux = m_guessed.top().common;
         #ifdef VERBOSE
         std::cout << "[Backtrace] Status: \n";
         showStatus();
         #endif
+        return true;
+    }
+
+    namespace
+    {
+        void writeAux(std::ostream& os, const Aux& aux)
+        {
+            os << aux.size();
+            for(auto& pair: aux)
+            {
+                os << " " << pair.first.first << pair.first.second << ":";
+                for(auto value: pair.second)
+                    os << value;
+            }
+            os << "\n";
+        }
+
+        void writeCommon(std::ostream& os, const std::vector<std::pair<Coord, Coord>>& common)
+        {
+            os << common.size();
+            for(auto& pair: common)
+            {
+                os << " " << pair.first.first << pair.first.second << "-"
+                    << pair.second.first << pair.second.second;
+            }
+            os << "\n";
+        }
+
+        Coord readCoord(const std::string& token, size_t offset)
+        {
+            if(token.size() < offset + 2 || token[offset] < '0' || token[offset] > '8' ||
+                token[offset + 1] < '0' || token[offset + 1] > '8')
+            {
+                throw std::runtime_error("Invalid cell in state: " + token);
+            }
+            return Coord(token[offset] - '0', token[offset + 1] - '0');
+        }
+
+        // "-" stands for an empty list
+        std::vector<int> readValues(const std::string& text)
+        {
+            std::vector<int> values;
+            if(text == "-")
+                return values;
+            for(auto c: text)
+            {
+                if(c < '1' || c > '9')
+                    throw std::runtime_error("Invalid value in state: " + text);
+                values.push_back(c - '0');
+            }
+            return values;
+        }
+
+        Aux readAux(std::istream& is)
+        {
+            Aux aux;
+            size_t num;
+            if(!(is >> num))
+                throw std::runtime_error("Truncated state");
+            for(size_t i=0; i<num; ++i)
+            {
+                std::string token;
+                if(!(is >> token) || token.size() < 3 || token[2] != ':')
+                    throw std::runtime_error("Invalid candidates in state");
+                aux[readCoord(token, 0)] = readValues(token.substr(3));
+            }
+            return aux;
+        }
+
+        std::vector<std::pair<Coord, Coord>> readCommon(std::istream& is)
+        {
+            std::vector<std::pair<Coord, Coord>> common;
+            size_t num;
+            if(!(is >> num))
+                throw std::runtime_error("Truncated state");
+            for(size_t i=0; i<num; ++i)
+            {
+                std::string token;
+                if(!(is >> token) || token.size() != 5 || token[2] != '-')
+                    throw std::runtime_error("Invalid pair in state");
+                common.push_back(std::make_pair(readCoord(token, 0), readCoord(token, 3)));
+            }
+            return common;
+        }
+
+        std::string readGrid(std::istream& is, const char* key)
+        {
+            std::string name, grid;
+            if(!(is >> name >> grid) || name != key || grid.size() != SIZE * SIZE ||
+                grid.find_first_not_of("0123456789") != std::string::npos)
+            {
+                throw std::runtime_error(std::string("Invalid ") + key + " in state");
+            }
+            return grid;
+        }
+    }
+
+    void Solver::saveState(std::ostream& os)
+    {
+        ensureAux();
+        os << "SDKS 2\ngivens ";
+        for(int cell=0; cell<SIZE * SIZE; ++cell)
+            os << static_cast<int>(m_givens[cell]);
+        os << "\ngrid ";
+        for(int cell=0; cell<SIZE * SIZE; ++cell)
+            os << getCell(Coord(cell / SIZE, cell % SIZE));
+        os << "\ncounters " << m_iter << " " << m_guess_num << " " << m_backtrace_num << " "
+            << m_probe_elimination_num << "\n";
+        writeAux(os, m_aux);
+        writeCommon(os, m_common_aux);
+        // bottom of the stack first
+        std::vector<Node> nodes;
+        for(std::stack<Node> stack = m_guessed; !stack.empty(); stack.pop())
+            nodes.push_back(stack.top());
+        os << "nodes " << nodes.size() << "\n";
+        for(auto it=nodes.rbegin(); it!=nodes.rend(); ++it)
+        {
+            // nodes pushed by setCell hold no candidates, "-" keeps the tokens in place
+            os << it->coord.first << it->coord.second << " ";
+            for(auto value: it->candidates)
+                os << value;
+            os << (it->candidates.empty()? "- ": " ");
+            for(auto guessed: it->guessed)
+                os << (guessed? 1: 0);
+            os << (it->guessed.empty()? "-\n": "\n");
+            writeAux(os, it->aux);
+            writeCommon(os, it->common);
+        }
+    }
+
+    void Solver::loadState(std::istream& is)
+    {
+        std::string magic;
+        int version;
+        if(!(is >> magic >> version) || magic != "SDKS" || version != 2)
+            throw std::runtime_error("Not a solver state");
+        std::string givens = readGrid(is, "givens");
+        for(int cell=0; cell<SIZE * SIZE; ++cell)
+        {
+            if(givens[cell] - '0' != m_givens[cell])
+                throw std::runtime_error("State saved for another puzzle");
+        }
+        std::string grid = readGrid(is, "grid");
+        std::string key;
+        int iter, guess_num, backtrace_num, probe_elimination_num;
+        if(!(is >> key >> iter >> guess_num >> backtrace_num >> probe_elimination_num) || key != "counters")
+            throw std::runtime_error("Invalid counters in state");
+        Aux aux = readAux(is);
+        std::vector<std::pair<Coord, Coord>> common = readCommon(is);
+        size_t node_num;
+        if(!(is >> key >> node_num) || key != "nodes")
+            throw std::runtime_error("Invalid nodes in state");
+        std::stack<Node> guessed;
+        for(size_t i=0; i<node_num; ++i)
+        {
+            std::string cell, candidates, flags;
+            if(!(is >> cell >> candidates >> flags))
+                throw std::runtime_error("Truncated state");
+            Coord coord = readCoord(cell, 0);
+            Aux node_aux = readAux(is);
+            Node node(coord, node_aux, readCommon(is));
+            node.candidates = readValues(candidates);
+            if(flags == "-")
+                flags.clear();
+            if(flags.size() != node.candidates.size())
+                throw std::runtime_error("Invalid node in state");
+            node.guessed.assign(flags.size(), false);
+            for(size_t j=0; j<flags.size(); ++j)
+                node.guessed[j] = flags[j] == '1';
+            guessed.push(node);
+        }
+        // everything parsed, only now touch the board
+        for(int cell=0; cell<SIZE * SIZE; ++cell)
+        {
+            Coord coord(cell / SIZE, cell % SIZE);
+            if(getCell(coord) != 0)
+                Problem::setCell(coord, 0);
+        }
+        for(int cell=0; cell<SIZE * SIZE; ++cell)
+        {
+            if(grid[cell] != '0')
+                Problem::setCell(Coord(cell / SIZE, cell % SIZE), grid[cell] - '0');
+        }
+        m_aux = aux;
+        m_aux_ready = true;
+        m_common_aux = common;
+        m_guessed = guessed;
+        m_iter = iter;
+        m_guess_num = guess_num;
+        m_backtrace_num = backtrace_num;
+        m_probe_elimination_num = probe_elimination_num;
+    }
+
+    bool Solver::saveStateFile(const char* filename)
+    {
+        std::string temp = std::string(filename) + ".tmp";
+        {
+            std::ofstream f(temp.c_str());
+            if(!f.is_open())
+                return false;
+            saveState(f);
+            f.flush();
+            if(!f)
+                return false;
+        }
+        return std::rename(temp.c_str(), filename) == 0;
+    }
+
+    bool Solver::loadStateFile(const char* filename)
+    {
+        std::ifstream f(filename);
+        if(!f.is_open())
+            return false;
+        try
+        {
+            loadState(f);
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << "Ignoring state " << filename << ": " << e.what() << "\n";
+            return false;
+        }
+        return true;
     }
-}
\ No newline at end of file
+}
@@ -4,10 +4,12 @@
 #include <unordered_map>
 #include <map>
 #include <stack>
+#include <chrono>
+#include <random>
 #include "Problem/Problem.h"
-#ifdef OPENMP
-#include <mutex>
-#endif
+#include "Solver/Options.h"
+#include "Trace/Trace.h"
+#include "Perf/Perf.h"
 
 namespace Sudoku
 {
@@ -70,12 +72,16 @@ namespace Sudoku
     {
     public:
         Solver(const char*);
+        Solver(const uint8_t grid[SIZE * SIZE], const std::vector<Cage>& cages=std::vector<Cage>(),
+            const Regions& regions=Regions());
         void setCell(Coord coord, int value, bool add_in_stack=true);
         void generateAux(Coord coord);
         void removeSameRowAux(Coord coord, std::vector<int> values, std::vector<Coord> excluded_coords={});
         void removeSameColumnAux(Coord coord, std::vector<int> values, std::vector<Coord> excluded_coords={});
         void removeSameBlockAux(Coord coord, std::vector<int> values, std::vector<Coord> excluded_coords={});
+        void removeSameCageAux(Coord coord, std::vector<int> values);
         void removeAux(Coord coord, std::vector<int> values, std::vector<Coord> excluded_coords={});
+        bool pruneCage(unsigned int cage_id, bool place_single=false);
         FrequencyMap countSameRowAuxFreqMap(unsigned int row);
         FrequencyMap countSameColumnAuxFreqMap(unsigned int column);
         FrequencyMap countSameBlockAuxFreqMap(unsigned int block_id);
@@ -83,25 +89,57 @@ namespace Sudoku
         void displayCommonAux(void);
         void displayFrequencyMap(Unit unit, unsigned int number, FrequencyMap map);
         void displayGuessHistory(void);
-        void solve(bool show_status=false);
+        Status solve(const Options& options=Options());
         void showStatus(void);
         bool isRecordedCell(Coord coord);
         void updateStatus(Coord coord);
+        bool probe(void);
         void guess(void);
-        void backtrace(void);
+        bool backtrace(void);
         int getIter(void) {return m_iter;}
         int getGuessNum(void) {return m_guess_num;}
         int getBacktraceNum(void) {return m_backtrace_num;}
+        int getProbeEliminationNum(void) {return m_probe_elimination_num;}
+        Status getStatus(void) {return m_status;}
+        // whether the last solve() continued from options.state_file
+        bool getResumed(void) {return m_resumed;}
+        const PerfSample& getPhasePerf(Phase phase) {return m_phase_perf[static_cast<int>(phase)];}
+        const Aux& getAux(void) {ensureAux(); return m_aux;}
+        // grid, candidates, decision stack and counters; loadState throws if the givens differ
+        void saveState(std::ostream& os);
+        void loadState(std::istream& is);
+        // written to a temporary file first, so a crash never leaves a torn state
+        bool saveStateFile(const char* filename);
+        bool loadStateFile(const char* filename);
     private:
+        void initAux(void);
+        void ensureAux(void);
+        bool interrupted(void);
+        bool recover(void);
+        void enterPhase(Phase phase);
+        void trace(TraceType type, Coord coord, int value)
+        {
+            traceEvent(type, coord.first * SIZE + coord.second, value, m_trace_rule, m_iter);
+        }
         Aux m_aux;
+        bool m_aux_ready;
+        std::array<uint8_t, SIZE * SIZE> m_givens;
         std::vector<std::pair<Coord, Coord>> m_common_aux;
         int m_iter;
         int m_guess_num;
         int m_backtrace_num;
+        int m_probe_elimination_num;
         std::stack<Node> m_guessed;
-        #ifdef OPENMP
-        std::mutex m_mutex;
-        #endif
+        Options m_options;
+        Status m_status;
+        std::chrono::steady_clock::time_point m_deadline;
+        std::mt19937 m_rng;
+        TraceRule m_trace_rule;  // technique credited for the next traced events
+        Phase m_phase;
+        PerfSample m_perf_mark;  // counters when m_phase was entered
+        PerfSample m_phase_perf[PHASE_NUM];
+        std::chrono::steady_clock::time_point m_next_checkpoint;
+        bool m_resumed;
     };
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include <memory>
+#include <stdexcept>
+#include "Sudoku.h"
+#include "Solver/Solver.h"
+#include "Cdcl/Cdcl.h"
+#include "Utilities/Utilities.h"
+
+namespace Sudoku
+{
+    Status solve(const uint8_t grid[CELLS], uint8_t out[CELLS],
+        const Options& options, Stats* stats)
+    {
+        return solve(grid, std::vector<Cage>(), out, options, stats);
+    }
+
+    Status solve(const uint8_t grid[CELLS], const std::vector<Cage>& cages, uint8_t out[CELLS],
+        const Options& options, Stats* stats)
+    {
+        return solve(grid, cages, Regions(), out, options, stats);
+    }
+
+    Status solve(const uint8_t grid[CELLS], const std::vector<Cage>& cages, const Regions& regions,
+        uint8_t out[CELLS], const Options& options, Stats* stats)
+    {
+        auto tic = std::chrono::steady_clock::now();
+        std::copy(grid, grid + CELLS, out);
+        PerfSample perf_start;
+        if(options.perf_counters)
+            perf_start = PerfCounters::thread().read();
+        // only bad input (duplicated givens, out of range values, broken cages or regions) is a status,
+        // failures of the search itself propagate
+        Status status = Status::Invalid;
+        if(options.engine == Engine::Cdcl && cages.empty() && regions.isStandard())
+        {
+            std::unique_ptr<CdclSolver> solver;
+            try
+            {
+                // rejects duplicated givens the same way the propagation engine does
+                Problem problem(grid);
+                solver.reset(new CdclSolver(grid));
+            }
+            catch(const std::runtime_error&)
+            {
+            }
+            if(solver != nullptr)
+            {
+                status = solver->solve(options);
+                solver->getGrid(out);
+                if(stats != nullptr)
+                {
+                    stats->iters = 0;
+                    stats->guesses = solver->getDecisionNum();
+                    stats->backtraces = solver->getBackjumpNum();
+                    stats->conflicts = solver->getConflictNum();
+                    stats->learned_clauses = solver->getLearnedNum();
+                    stats->restarts = solver->getRestartNum();
+                    for(int i=0; i<CELLS; ++i)
+                        stats->candidates[i] = out[i] == 0? solver->getCandidateMask(i): 0;
+                }
+            }
+        }
+        else
+        {
+            std::unique_ptr<Solver> solver;
+            try
+            {
+                solver.reset(new Solver(grid, cages, regions));
+            }
+            catch(const std::runtime_error&)
+            {
+            }
+            if(solver != nullptr)
+            {
+                status = solver->solve(options);
+                for(int i=0; i<CELLS; ++i)
+                {
+                    out[i] = solver->getCell(Coord(i / SIZE, i % SIZE));
+                }
+                if(stats != nullptr)
+                {
+                    stats->iters = solver->getIter();
+                    stats->guesses = solver->getGuessNum();
+                    stats->backtraces = solver->getBacktraceNum();
+                    stats->probe_eliminations = solver->getProbeEliminationNum();
+                    stats->resumed = solver->getResumed();
+                    for(int i=0; i<PHASE_NUM; ++i)
+                        stats->phases[i] = solver->getPhasePerf(static_cast<Phase>(i));
+                    std::fill(stats->candidates, stats->candidates + CELLS, 0);
+                    for(auto pair: solver->getAux())
+                    {
+                        uint16_t mask = 0;
+                        for(auto value: pair.second)
+                            mask |= 1 << value;
+                        stats->candidates[pair.first.first * SIZE + pair.first.second] = mask;
+                    }
+                }
+            }
+        }
+        if(stats != nullptr)
+        {
+            stats->elapsed_us = getTimeDiff(tic);
+            if(options.perf_counters)
+                stats->perf = PerfCounters::thread().read() - perf_start;
+        }
+        return status;
+    }
+
+    void loadProblem(const char* filename, uint8_t grid[CELLS], std::vector<Cage>* cages, Regions* regions)
+    {
+        Problem problem(filename);
+        if(regions != nullptr)
+            *regions = problem.getRegions();
+        if(cages != nullptr)
+        {
+            cages->clear();
+            for(unsigned int cage_id=0; cage_id<problem.getCageNum(); ++cage_id)
+                cages->push_back(problem.getCage(cage_id));
+        }
+        for(int i=0; i<CELLS; ++i)
+        {
+            grid[i] = problem.getCell(Coord(i / SIZE, i % SIZE));
+        }
+    }
+
+    bool parseGrid(const char* text, size_t length, uint8_t grid[CELLS])
+    {
+        if(length < CELLS)
+            return false;
+        for(int i=0; i<CELLS; ++i)
+        {
+            char c = text[i];
+            if(c >= '1' && c <= '9')
+                grid[i] = c - '0';
+            else if(c == '0' || c == '.')
+                grid[i] = 0;
+            else
+                return false;
+        }
+        for(size_t i=CELLS; i<length; ++i)
+        {
+            if(text[i] != ' ' && text[i] != '\t' && text[i] != '\r')
+                return false;
+        }
+        return true;
+    }
+}
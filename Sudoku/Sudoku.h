@@ -0,0 +1,69 @@
+#ifndef _SUDOKU_H
+#define _SUDOKU_H
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include "Problem/Problem.h"
+#include "Solver/Options.h"
+#include "Perf/Perf.h"
+
+#define CELLS 81
+
+/*
+ * Library entry points, safe to call in-process:
+ * nothing is printed (unless options.show_status is set) and nothing exits.
+ * Grids are row-major, 0 for an empty cell.
+ */
+namespace Sudoku
+{
+    using Grid = std::array<uint8_t, CELLS>;
+
+    struct Stats
+    {
+        int iters;
+        int guesses;
+        int backtraces;
+        int probe_eliminations;         // candidates removed by failed-candidate probing
+        unsigned long conflicts;        // CDCL engine only
+        unsigned long learned_clauses;
+        unsigned long restarts;
+        double elapsed_us;
+        bool resumed;                   // continued from options.state_file
+        PerfSample perf;                // whole solve, valid only with options.perf_counters
+        PerfSample phases[PHASE_NUM];   // propagation engine only
+        uint16_t candidates[CELLS];  // bit v set if v is still possible, filled when not solved
+
+        Stats():
+            iters(0),
+            guesses(0),
+            backtraces(0),
+            probe_eliminations(0),
+            conflicts(0),
+            learned_clauses(0),
+            restarts(0),
+            elapsed_us(0),
+            resumed(false),
+            perf(),
+            phases(),
+            candidates()
+        {}
+    };
+
+    Status solve(const uint8_t grid[CELLS], uint8_t out[CELLS],
+        const Options& options=Options(), Stats* stats=nullptr);
+    // Killer variant, the cages are checked and pruned along with rows, columns and blocks
+    // (by the propagation engine, whatever options.engine says)
+    Status solve(const uint8_t grid[CELLS], const std::vector<Cage>& cages, uint8_t out[CELLS],
+        const Options& options=Options(), Stats* stats=nullptr);
+    // Jigsaw variant, blocks follow the regions (propagation engine only, like cages)
+    Status solve(const uint8_t grid[CELLS], const std::vector<Cage>& cages, const Regions& regions,
+        uint8_t out[CELLS], const Options& options=Options(), Stats* stats=nullptr);
+    // read a "row col value" problem file (plus "K sum rc rc ..." cage lines and an
+    // "R <81 region digits>" line), throws std::runtime_error on failure
+    void loadProblem(const char* filename, uint8_t grid[CELLS], std::vector<Cage>* cages=nullptr,
+        Regions* regions=nullptr);
+    // 81 characters, '1'-'9' for values, '0' or '.' for empty cells, trailing blanks allowed
+    bool parseGrid(const char* text, size_t length, uint8_t grid[CELLS]);
+};
+#endif
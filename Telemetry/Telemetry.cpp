@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "Telemetry.h"
+
+namespace Sudoku
+{
+    namespace
+    {
+        std::runtime_error systemError(const std::string& what)
+        {
+            return std::runtime_error(what + ": " + std::strerror(errno));
+        }
+
+        std::atomic<uint64_t> g_telemetry_num(0);
+
+        struct LocalShard
+        {
+            uint64_t owner;
+            void* shard;
+        };
+        thread_local LocalShard t_shard = {0, nullptr};
+
+        void writeDistribution(std::ostream& os, const Histogram& histogram)
+        {
+            os << "{\"mean\": " << histogram.getMean() << ", \"p50\": " << histogram.percentile(0.5)
+                << ", \"p99\": " << histogram.percentile(0.99) << ", \"p999\": " << histogram.percentile(0.999)
+                << ", \"max\": " << histogram.getMax() << "}";
+        }
+    }
+
+    Histogram::Histogram():
+        m_counts(),
+        m_count(0),
+        m_max(0),
+        m_sum(0)
+    {}
+
+    unsigned int Histogram::bucket(uint64_t value)
+    {
+        if(value < (1u << SUB_BUCKET_BITS))
+            return value;
+        unsigned int exponent = 63 - __builtin_clzll(value);
+        unsigned int sub = (value >> (exponent - SUB_BUCKET_BITS)) & ((1u << SUB_BUCKET_BITS) - 1);
+        return ((exponent - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + sub;
+    }
+
+    uint64_t Histogram::upperBound(unsigned int bucket)
+    {
+        if(bucket < (1u << SUB_BUCKET_BITS))
+            return bucket;
+        unsigned int exponent = (bucket >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+        uint64_t sub = bucket & ((1u << SUB_BUCKET_BITS) - 1);
+        uint64_t width = uint64_t(1) << (exponent - SUB_BUCKET_BITS);
+        return (((uint64_t(1) << SUB_BUCKET_BITS) + sub) << (exponent - SUB_BUCKET_BITS)) + width - 1;
+    }
+
+    void Histogram::record(uint64_t value)
+    {
+        ++m_counts[bucket(value)];
+        ++m_count;
+        m_sum += value;
+        m_max = std::max(m_max, value);
+    }
+
+    void Histogram::merge(const Histogram& other)
+    {
+        for(int i=0; i<HISTOGRAM_BUCKETS; ++i)
+            m_counts[i] += other.m_counts[i];
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    uint64_t Histogram::percentile(double q) const
+    {
+        if(m_count == 0)
+            return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * m_count + 0.5));
+        uint64_t seen = 0;
+        for(int i=0; i<HISTOGRAM_BUCKETS; ++i)
+        {
+            seen += m_counts[i];
+            if(seen >= rank)
+                return std::min(upperBound(i), m_max);
+        }
+        return m_max;
+    }
+
+    void TelemetrySample::merge(const TelemetrySample& other)
+    {
+        latency_us.merge(other.latency_us);
+        guesses.merge(other.guesses);
+        backtraces.merge(other.backtraces);
+        solved += other.solved;
+        failed += other.failed;
+        slowest.insert(slowest.end(), other.slowest.begin(), other.slowest.end());
+        std::sort(slowest.begin(), slowest.end(), std::greater<std::pair<uint64_t, uint64_t>>());
+        if(slowest.size() > SLOWEST_NUM)
+            slowest.resize(SLOWEST_NUM);
+    }
+
+    Telemetry::Telemetry(const std::string& target, long long interval_us):
+        m_id(++g_telemetry_num),
+        m_socket(target.compare(0, 5, "unix:") == 0),
+        m_interval_us(std::max(1000LL, interval_us)),
+        m_listen_fd(-1),
+        m_file(nullptr),
+        m_start(std::chrono::steady_clock::now()),
+        m_last(m_start),
+        m_last_count(0)
+    {
+        m_path = m_socket? target.substr(5): target;
+        if(m_socket)
+        {
+            sockaddr_un addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            if(m_path.size() >= sizeof(addr.sun_path))
+                throw std::runtime_error("Socket path too long: " + m_path);
+            std::strcpy(addr.sun_path, m_path.c_str());
+            m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if(m_listen_fd < 0)
+                throw systemError("socket");
+            unlink(addr.sun_path);
+            if(bind(m_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+                ::listen(m_listen_fd, SOMAXCONN) < 0)
+            {
+                std::runtime_error error = systemError("bind");
+                ::close(m_listen_fd);
+                throw error;
+            }
+        }
+        else
+        {
+            m_file = std::fopen(m_path.c_str(), "a");
+            if(m_file == nullptr)
+                throw std::runtime_error("Failed to open file: " + m_path);
+        }
+        if(pipe2(m_wake_fd, O_CLOEXEC) < 0)
+        {
+            std::runtime_error error = systemError("pipe2");
+            if(m_socket)
+                ::close(m_listen_fd);
+            else
+                std::fclose(m_file);
+            throw error;
+        }
+        m_latest = snapshot();
+        m_reporter = std::thread(&Telemetry::report, this);
+    }
+
+    Telemetry::~Telemetry()
+    {
+        char stop = 0;
+        if(write(m_wake_fd[1], &stop, 1) < 0)
+            std::perror("write");
+        m_reporter.join();
+        ::close(m_wake_fd[0]);
+        ::close(m_wake_fd[1]);
+        if(m_socket)
+        {
+            ::close(m_listen_fd);
+            unlink(m_path.c_str());
+        }
+        else
+            std::fclose(m_file);
+    }
+
+    Telemetry::Shard& Telemetry::local(void)
+    {
+        if(t_shard.owner != m_id)
+        {
+            std::lock_guard<std::mutex> guard(m_shards_mutex);
+            m_shards.push_back(std::unique_ptr<Shard>(new Shard()));
+            t_shard.owner = m_id;
+            t_shard.shard = m_shards.back().get();
+        }
+        return *static_cast<Shard*>(t_shard.shard);
+    }
+
+    void Telemetry::record(uint64_t id, Status status, double elapsed_us, unsigned int guesses,
+        unsigned int backtraces)
+    {
+        Shard& shard = local();
+        uint64_t latency = elapsed_us > 0? static_cast<uint64_t>(elapsed_us + 0.5): 0;
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        TelemetrySample& sample = shard.sample;
+        sample.latency_us.record(latency);
+        sample.guesses.record(guesses);
+        sample.backtraces.record(backtraces);
+        if(status == Status::Solved)
+            ++sample.solved;
+        else
+            ++sample.failed;
+        // kept sorted longest first
+        std::vector<std::pair<uint64_t, uint64_t>>& slowest = sample.slowest;
+        if(slowest.size() == SLOWEST_NUM && latency <= slowest.back().first)
+            return;
+        auto entry = std::make_pair(latency, id);
+        slowest.insert(std::upper_bound(slowest.begin(), slowest.end(), entry,
+            std::greater<std::pair<uint64_t, uint64_t>>()), entry);
+        if(slowest.size() > SLOWEST_NUM)
+            slowest.pop_back();
+    }
+
+    std::string Telemetry::snapshot(void)
+    {
+        TelemetrySample total;
+        size_t threads;
+        {
+            std::lock_guard<std::mutex> guard(m_shards_mutex);
+            threads = m_shards.size();
+            for(auto& shard: m_shards)
+            {
+                std::lock_guard<std::mutex> shard_guard(shard->mutex);
+                total.merge(shard->sample);
+            }
+        }
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - m_start).count();
+        double window = std::chrono::duration<double>(now - m_last).count();
+        uint64_t count = total.latency_us.getCount();
+        std::ostringstream os;
+        os << "{\"elapsed_s\": " << elapsed << ", \"puzzles\": " << count << ", \"solved\": " << total.solved
+            << ", \"failed\": " << total.failed << ", \"throughput\": " << (elapsed > 0? count / elapsed: 0)
+            << ", \"recent_throughput\": " << (window > 0? (count - m_last_count) / window: 0)
+            << ", \"threads\": " << threads << ", \"latency_us\": ";
+        writeDistribution(os, total.latency_us);
+        os << ", \"guesses\": ";
+        writeDistribution(os, total.guesses);
+        os << ", \"backtraces\": ";
+        writeDistribution(os, total.backtraces);
+        os << ", \"slowest\": [";
+        for(size_t i=0; i<total.slowest.size(); ++i)
+        {
+            os << (i == 0? "": ", ") << "{\"id\": " << total.slowest[i].second
+                << ", \"us\": " << total.slowest[i].first << "}";
+        }
+        os << "]}";
+        m_last = now;
+        m_last_count = count;
+        return os.str();
+    }
+
+    void Telemetry::publish(const std::string& json)
+    {
+        if(m_socket)
+        {
+            m_latest = json + "\n";
+            return;
+        }
+        std::fputs(json.c_str(), m_file);
+        std::fputc('\n', m_file);
+        std::fflush(m_file);
+    }
+
+    void Telemetry::report(void)
+    {
+        auto next = std::chrono::steady_clock::now() + std::chrono::microseconds(m_interval_us);
+        while(true)
+        {
+            pollfd fds[2] = {{m_wake_fd[0], POLLIN, 0}, {m_listen_fd, POLLIN, 0}};
+            long long timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+                next - std::chrono::steady_clock::now()).count();
+            int ret = poll(fds, m_socket? 2: 1, std::max(0LL, timeout));
+            if(ret < 0 && errno != EINTR)
+                break;
+            if(ret > 0 && (fds[0].revents & POLLIN))
+                break;
+            if(ret > 0 && m_socket && (fds[1].revents & POLLIN))
+            {
+                int fd;
+                while((fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_CLOEXEC)) >= 0)
+                {
+                    // small enough for the socket buffer, a client that never reads cannot stall us
+                    if(send(fd, m_latest.data(), m_latest.size(), MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+                        std::perror("send");
+                    ::close(fd);
+                }
+            }
+            if(std::chrono::steady_clock::now() >= next)
+            {
+                publish(snapshot());
+                next = std::chrono::steady_clock::now() + std::chrono::microseconds(m_interval_us);
+            }
+        }
+        publish(snapshot());
+    }
+};
@@ -0,0 +1,98 @@
+#ifndef _TELEMETRY_H
+#define _TELEMETRY_H
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Sudoku/Sudoku.h"
+
+#define SUB_BUCKET_BITS 5   // 32 linear buckets per power of two, about 3% relative error
+#define HISTOGRAM_BUCKETS ((64 - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS)
+#define SLOWEST_NUM 10
+
+namespace Sudoku
+{
+    // HDR-style log-linear histogram: exact below 32, then 32 buckets per power of two
+    class Histogram
+    {
+    public:
+        Histogram();
+        void record(uint64_t value);
+        void merge(const Histogram& other);
+        uint64_t getCount(void) const {return m_count;}
+        uint64_t getMax(void) const {return m_max;}
+        double getMean(void) const {return m_count == 0? 0: static_cast<double>(m_sum) / m_count;}
+        // upper bound of the bucket holding the q-quantile (0 < q <= 1), capped at the maximum
+        uint64_t percentile(double q) const;
+    private:
+        static unsigned int bucket(uint64_t value);
+        static uint64_t upperBound(unsigned int bucket);
+        std::array<uint64_t, HISTOGRAM_BUCKETS> m_counts;
+        uint64_t m_count;
+        uint64_t m_max;
+        uint64_t m_sum;
+    };
+
+    struct TelemetrySample
+    {
+        Histogram latency_us;
+        Histogram guesses;
+        Histogram backtraces;
+        uint64_t solved;
+        uint64_t failed;                                // anything but Solved
+        std::vector<std::pair<uint64_t, uint64_t>> slowest;  // (elapsed_us, id), at most SLOWEST_NUM
+
+        TelemetrySample():
+            solved(0),
+            failed(0)
+        {}
+        void merge(const TelemetrySample& other);
+    };
+
+    /*
+     * Workers record into a shard of their own thread, behind a lock only the
+     * reporter ever contends for. Every interval the reporter merges the shards
+     * and publishes a JSON snapshot: throughput, latency percentiles, guess and
+     * backtrace distributions and the slowest puzzle ids.
+     */
+    class Telemetry
+    {
+    public:
+        // target: a file, one snapshot appended per line, or "unix:<path>", a socket
+        // answering every connection with the latest snapshot; throws std::runtime_error
+        Telemetry(const std::string& target, long long interval_us=1000000);
+        // publishes a final snapshot
+        ~Telemetry();
+        // thread-safe, called by the workers once per puzzle
+        void record(uint64_t id, Status status, double elapsed_us, unsigned int guesses, unsigned int backtraces);
+    private:
+        struct Shard
+        {
+            std::mutex mutex;
+            TelemetrySample sample;
+        };
+        Shard& local(void);
+        std::string snapshot(void);
+        void report(void);
+        void publish(const std::string& json);
+        uint64_t m_id;          // tells thread caches of different instances apart
+        std::string m_path;
+        bool m_socket;
+        long long m_interval_us;
+        int m_listen_fd;
+        int m_wake_fd[2];
+        FILE* m_file;
+        std::chrono::steady_clock::time_point m_start;
+        std::chrono::steady_clock::time_point m_last;
+        uint64_t m_last_count;
+        std::mutex m_shards_mutex;
+        std::vector<std::unique_ptr<Shard>> m_shards;
+        std::string m_latest;
+        std::thread m_reporter;
+    };
+};
+#endif
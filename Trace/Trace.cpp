@@ -0,0 +1,105 @@
+#include <cstdio>
+#include <cstring>
+#include "Trace.h"
+
+namespace Sudoku
+{
+    thread_local TraceBuffer* t_trace = nullptr;
+
+    TraceBuffer::TraceBuffer(size_t capacity):
+        m_events(capacity == 0? 1: capacity),
+        m_head(0),
+        m_total(0)
+    {}
+
+    std::vector<TraceEvent> TraceBuffer::events(void) const
+    {
+        if(m_total <= m_events.size())
+            return std::vector<TraceEvent>(m_events.begin(), m_events.begin() + m_total);
+        std::vector<TraceEvent> events(m_events.begin() + m_head, m_events.end());
+        events.insert(events.end(), m_events.begin(), m_events.begin() + m_head);
+        return events;
+    }
+
+    bool TraceBuffer::dump(const char* filename) const
+    {
+        FILE* f = std::fopen(filename, "wb");
+        if(f == nullptr)
+            return false;
+        std::vector<TraceEvent> ordered = events();
+        TraceHeader header;
+        std::memcpy(header.magic, "SDKT", 4);
+        header.version = 1;
+        header.event_size = sizeof(TraceEvent);
+        header.reserved = 0;
+        header.count = ordered.size();
+        header.dropped = getDropped();
+        bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1 &&
+            std::fwrite(ordered.data(), sizeof(TraceEvent), ordered.size(), f) == ordered.size();
+        return std::fclose(f) == 0 && ok;
+    }
+
+    void startTrace(size_t capacity)
+    {
+        delete t_trace;
+        t_trace = new TraceBuffer(capacity);
+    }
+
+    void stopTrace(void)
+    {
+        delete t_trace;
+        t_trace = nullptr;
+    }
+
+    const char* toString(TraceType type)
+    {
+        switch(type)
+        {
+            case TraceType::Begin:
+                return "begin";
+            case TraceType::Set:
+                return "set";
+            case TraceType::Eliminate:
+                return "eliminate";
+            case TraceType::Guess:
+                return "guess";
+            case TraceType::Backtrace:
+                return "backtrace";
+            case TraceType::Contradiction:
+                return "contradiction";
+        }
+        return "unknown";
+    }
+
+    const char* toString(TraceRule rule)
+    {
+        switch(rule)
+        {
+            case TraceRule::None:
+                return "none";
+            case TraceRule::Peer:
+                return "peer";
+            case TraceRule::Single:
+                return "single";
+            case TraceRule::HiddenRow:
+                return "hidden row";
+            case TraceRule::HiddenColumn:
+                return "hidden column";
+            case TraceRule::HiddenBlock:
+                return "hidden block";
+            case TraceRule::Pair:
+                return "pair";
+            case TraceRule::Pointing:
+                return "pointing";
+            case TraceRule::Cage:
+                return "cage";
+            case TraceRule::Probe:
+                return "probe";
+            case TraceRule::Guess:
+                return "guess";
+            case TraceRule::Clause:
+                return "clause";
+        }
+        return "unknown";
+    }
+}
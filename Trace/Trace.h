@@ -0,0 +1,99 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/*
+ * Runtime solve trace: fixed-size binary events appended to a ring buffer
+ * owned by the recording thread. Recording is a thread-local pointer test
+ * when disabled and an 8-byte store when enabled; decode with trace_decode.
+ */
+namespace Sudoku
+{
+    enum class TraceType: uint8_t {
+        Begin,          // new solve, value holds the number of givens
+        Set,
+        Eliminate,
+        Guess,
+        Backtrace,      // cell of the resumed node, value holds the popped nodes (capped at 255)
+        Contradiction
+    };
+
+    enum class TraceRule: uint8_t {
+        None,
+        Peer,           // value placed in the row/column/block/cage
+        Single,         // only one aux in the cell
+        HiddenRow,      // aux number only once in the row
+        HiddenColumn,
+        HiddenBlock,
+        Pair,           // two cells sharing the same two aux numbers
+        Pointing,       // aux number of a block confined to one line
+        Cage,
+        Probe,
+        Guess,
+        Clause          // unit propagation of a CDCL clause
+    };
+
+    struct TraceEvent
+    {
+        uint8_t type;
+        uint8_t cell;   // row * 9 + column, 255 if unknown
+        uint8_t value;
+        uint8_t rule;
+        uint32_t iter;
+    };
+
+    struct TraceHeader
+    {
+        char magic[4];      // "SDKT"
+        uint32_t version;
+        uint32_t event_size;
+        uint32_t reserved;
+        uint64_t count;     // events stored in the file
+        uint64_t dropped;   // oldest events overwritten by the ring
+    };
+
+    class TraceBuffer
+    {
+    public:
+        TraceBuffer(size_t capacity);
+        void push(TraceType type, uint8_t cell, uint8_t value, TraceRule rule, uint32_t iter)
+        {
+            TraceEvent& event = m_events[m_head];
+            event.type = static_cast<uint8_t>(type);
+            event.cell = cell;
+            event.value = value;
+            event.rule = static_cast<uint8_t>(rule);
+            event.iter = iter;
+            if(++m_head == m_events.size())
+                m_head = 0;
+            ++m_total;
+        }
+        // events oldest first
+        std::vector<TraceEvent> events(void) const;
+        uint64_t getDropped(void) const {return m_total > m_events.size()? m_total - m_events.size(): 0;}
+        bool dump(const char* filename) const;
+    private:
+        std::vector<TraceEvent> m_events;
+        size_t m_head;
+        uint64_t m_total;
+    };
+
+    // buffer the calling thread records into, nullptr when tracing is off
+    extern thread_local TraceBuffer* t_trace;
+
+    void startTrace(size_t capacity);
+    void stopTrace(void);
+
+    inline void traceEvent(TraceType type, uint8_t cell, uint8_t value, TraceRule rule, uint32_t iter)
+    {
+        if(t_trace != nullptr)
+            t_trace->push(type, cell, value, rule, iter);
+    }
+
+    const char* toString(TraceType type);
+    const char* toString(TraceRule rule);
+};
+#endif
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Trace.h"
+
+using namespace Sudoku;
+
+namespace
+{
+    const int TYPE_NUM = static_cast<int>(TraceType::Contradiction) + 1;
+    const int RULE_NUM = static_cast<int>(TraceRule::Clause) + 1;
+
+    void printEvent(const TraceEvent& event)
+    {
+        TraceType type = static_cast<TraceType>(event.type);
+        std::printf("%8u %-13s", event.iter, toString(type));
+        if(event.cell != 255)
+            std::printf(" (%d, %d)", event.cell / 9, event.cell % 9);
+        switch(type)
+        {
+            case TraceType::Begin:
+                std::printf(" %d givens", event.value);
+                break;
+            case TraceType::Set:
+            case TraceType::Guess:
+                std::printf(" = %d", event.value);
+                break;
+            case TraceType::Eliminate:
+                std::printf(" -%d", event.value);
+                break;
+            case TraceType::Backtrace:
+                std::printf(" %d nodes popped", event.value);
+                break;
+            default:
+                break;
+        }
+        if(event.rule != static_cast<uint8_t>(TraceRule::None))
+            std::printf(" [%s]", toString(static_cast<TraceRule>(event.rule)));
+        std::printf("\n");
+    }
+
+    void printSummary(const std::vector<TraceEvent>& events)
+    {
+        unsigned long types[TYPE_NUM] = {};
+        unsigned long sets[RULE_NUM] = {};
+        unsigned long eliminations[RULE_NUM] = {};
+        for(auto& event: events)
+        {
+            if(event.type >= TYPE_NUM || event.rule >= RULE_NUM)
+                continue;
+            ++types[event.type];
+            if(event.type == static_cast<uint8_t>(TraceType::Set))
+                ++sets[event.rule];
+            else if(event.type == static_cast<uint8_t>(TraceType::Eliminate))
+                ++eliminations[event.rule];
+        }
+        std::printf("%-16s %10s\n", "event", "count");
+        for(int i=0; i<TYPE_NUM; ++i)
+            std::printf("%-16s %10lu\n", toString(static_cast<TraceType>(i)), types[i]);
+        std::printf("\n%-16s %10s %10s\n", "rule", "set", "eliminate");
+        for(int i=0; i<RULE_NUM; ++i)
+        {
+            if(sets[i] == 0 && eliminations[i] == 0)
+                continue;
+            std::printf("%-16s %10lu %10lu\n", toString(static_cast<TraceRule>(i)), sets[i], eliminations[i]);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool summary = argc == 3 && std::strcmp(argv[2], "--summary") == 0;
+    if(argc != 2 && !summary)
+    {
+        std::fprintf(stderr, "Usage: %s <trace file> [--summary]\n", argv[0]);
+        return -1;
+    }
+    FILE* f = std::fopen(argv[1], "rb");
+    if(f == nullptr)
+    {
+        std::fprintf(stderr, "Failed to open file: %s\n", argv[1]);
+        return -1;
+    }
+    TraceHeader header;
+    if(std::fread(&header, sizeof(header), 1, f) != 1 || std::memcmp(header.magic, "SDKT", 4) != 0 ||
+        header.version != 1 || header.event_size != sizeof(TraceEvent))
+    {
+        std::fprintf(stderr, "Not a trace file: %s\n", argv[1]);
+        std::fclose(f);
+        return -1;
+    }
+    // the header count is not trusted with the allocation, a corrupt one would ask for gigabytes
+    long start = std::ftell(f);
+    unsigned long long available = 0;
+    if(start >= 0 && std::fseek(f, 0, SEEK_END) == 0)
+    {
+        long end = std::ftell(f);
+        if(end >= start)
+            available = (end - start) / sizeof(TraceEvent);
+        std::fseek(f, start, SEEK_SET);
+    }
+    if(header.count > available)
+        std::fprintf(stderr, "Truncated trace: %llu of %llu events\n", available,
+            static_cast<unsigned long long>(header.count));
+    std::vector<TraceEvent> events(std::min<unsigned long long>(header.count, available));
+    size_t count = std::fread(events.data(), sizeof(TraceEvent), events.size(), f);
+    std::fclose(f);
+    events.resize(count);
+    if(header.dropped != 0)
+        std::printf("(%llu older events overwritten)\n", static_cast<unsigned long long>(header.dropped));
+    if(summary)
+        printSummary(events);
+    else
+    {
+        for(auto& event: events)
+            printEvent(event);
+    }
+    return 0;
+}
@@ -63,73 +63,43 @@ unsigned int computeBlockId(Coord coord)
     return (row / 3) * 3 + column / 3;
 }
 
-std::vector<Coord> getBlockCoords(unsigned int block_id)
+unsigned int maskCount(uint16_t mask)
 {
-    unsigned int row = (block_id / 3) * 3;
-    unsigned int col = (block_id % 3) * 3;
-    std::vector<Coord> coords;
-    for(int i=0; i<3; ++i)
-    {
-        for(int j=0; j<3; ++j)
-        {
-            coords.push_back(std::make_pair(row + i, col + j));
-        }
-    }
-    return coords;
+    return __builtin_popcount(mask);
 }
 
-std::vector<Coord> getBlockCoords(Coord coord)
+int maskSum(uint16_t mask)
 {
-    unsigned int row = coord.first, column = coord.second;
-    int row_start, row_stop, col_start, col_stop;
-    switch(row % 3)
-    {
-        case 0:
-            row_start = 0;
-            row_stop = 2;
-            break;
-
-        case 1:
-            row_start = -1;
-            row_stop = 1;
-            break;
-
-        case 2:
-            row_start = -2;
-            row_stop = 0;
-            break;
-    }
-    switch(column % 3)
+    int sum = 0;
+    for(int value=1; value<=9; ++value)
     {
-        case 0:
-            col_start = 0;
-            col_stop = 2;
-            break;
-
-        case 1:
-            col_start = -1;
-            col_stop = 1;
-            break;
-
-        case 2:
-            col_start = -2;
-            col_stop = 0;
-            break;
+        if(mask & (1 << value))
+            sum += value;
     }
+    return sum;
+}
 
-    std::vector<Coord> coords;
-    for(int i = row_start; i<= row_stop; ++i)
+const std::vector<uint16_t>& cageCombinations(unsigned int size, int sum)
+{
+    // sizes 0..9, sums 0..45, built once from the 512 digit subsets
+    static const std::vector<std::vector<uint16_t>> table = []()
     {
-        for(int j = col_start; j<= col_stop; ++j)
+        std::vector<std::vector<uint16_t>> table(10 * 46);
+        for(uint16_t subset=0; subset<512; ++subset)
         {
-            coords.push_back(std::make_pair(row + i, column + j));
+            uint16_t mask = subset << 1;
+            table[maskCount(mask) * 46 + maskSum(mask)].push_back(mask);
         }
-    }
-    return coords;
+        return table;
+    }();
+    static const std::vector<uint16_t> empty;
+    if(size > 9 || sum < 0 || sum > 45)
+        return empty;
+    return table[size * 46 + sum];
 }
 
-double getTimeDiff(std::chrono::time_point<std::chrono::system_clock> tic)
+double getTimeDiff(std::chrono::time_point<std::chrono::steady_clock> tic)
 {
-    auto toc = std::chrono::system_clock::now();
-    return std::chrono::duration_cast<std::chrono::microseconds>(toc - tic).count();
+    auto toc = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(toc - tic).count();
 }
\ No newline at end of file
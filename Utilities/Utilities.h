@@ -1,7 +1,9 @@
 #ifndef _UTILITIES_H_
 #define _UTILITIES_H_
 
+#include <cstdint>
 #include <utility>
+#include <string>
 #include <array>
 #include <vector>
 #include <iostream>
@@ -25,28 +27,36 @@ std::ostream& operator<<(std::ostream& os, const std::vector<int> vec);
 template <std::size_t N>
 void printArray(const std::array<int, N>& arr)
 {
+    std::string text;
     for(int i=0; i<N; ++i)
     {
         int value = arr[i];
-        std::cout << (value == 0? " ": std::to_string(value)) << " ";
+        text.push_back(value == 0? ' ': '0' + value);
+        text.push_back(' ');
     }
+    std::cout.write(text.data(), text.size());
 }
 template <std::size_t N, std::size_t M>
 void print2DArray(const std::array<std::array<int, M>, N>& arr)
 {
+    // formatted in place and written once
+    std::string text;
+    text.reserve(N * (3 * M + 2));
     for(int row=0; row<N; ++row)
     {
         for(int col=0; col<M; ++col)
         {
             int value = arr[row][col];
-            std::cout << (value == 0? " ": std::to_string(value)) << " ";
+            text.push_back(value == 0? ' ': '0' + value);
+            text.push_back(' ');
             if(col % 3 == 2)
-                std::cout << " ";
+                text.push_back(' ');
         }
         if(row % 3 == 2)
-            std::cout << "\n";
-        std::cout << "\n";
+            text.push_back('\n');
+        text.push_back('\n');
     }
+    std::cout.write(text.data(), text.size());
 };
 std::array<int, 9> flattenBlock(std::array<std::array<int, 3>, 3>);
 bool valueInside(std::array<int, 9>, int);
@@ -54,8 +64,10 @@ bool valueInside(std::vector<int>, int);
 bool eraseValue(std::vector<int>&, int);
 bool coordInside(std::vector<Coord> coords, Coord coord);
 unsigned int computeBlockId(Coord coord);
-std::vector<Coord> getBlockCoords(unsigned int block_id);
-std::vector<Coord> getBlockCoords(Coord coord);
-double getTimeDiff(std::chrono::time_point<std::chrono::system_clock> tic);
+unsigned int maskCount(uint16_t mask);
+int maskSum(uint16_t mask);
+// 9-bit digit sets (bit v for digit v) of the given size adding up to sum
+const std::vector<uint16_t>& cageCombinations(unsigned int size, int sum);
+double getTimeDiff(std::chrono::time_point<std::chrono::steady_clock> tic);
 
 #endif
\ No newline at end of file
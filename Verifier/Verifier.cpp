@@ -0,0 +1,105 @@
+#include <thread>
+#include <cstring>
+#include "Verifier.h"
+
+namespace Sudoku
+{
+    const char* toString(Verdict verdict)
+    {
+        switch(verdict)
+        {
+            case Verdict::Pass:
+                return "PASS";
+            case Verdict::Malformed:
+                return "malformed";
+            case Verdict::GivenChanged:
+                return "given changed";
+            case Verdict::Duplicated:
+                return "duplicated";
+            case Verdict::Incomplete:
+                return "incomplete";
+            case Verdict::OutOfRange:
+                return "out of range";
+        }
+        return "unknown";
+    }
+
+    VerifyResult verify(const uint8_t puzzle[CELLS], const uint8_t grid[CELLS],
+        bool require_complete)
+    {
+        uint16_t row_mask[9] = {0}, column_mask[9] = {0}, block_mask[9] = {0};
+        for(int i=0; i<CELLS; ++i)
+        {
+            int value = grid[i];
+            if(value > SIZE || puzzle[i] > SIZE)
+                return VerifyResult(Verdict::OutOfRange, i);
+            if(puzzle[i] != 0 && value != puzzle[i])
+                return VerifyResult(Verdict::GivenChanged, i);
+            if(value == 0)
+            {
+                if(require_complete)
+                    return VerifyResult(Verdict::Incomplete, i);
+                continue;
+            }
+            int row = i / 9, column = i % 9, block_id = (row / 3) * 3 + column / 3;
+            uint16_t bit = 1 << value;
+            if((row_mask[row] | column_mask[column] | block_mask[block_id]) & bit)
+                return VerifyResult(Verdict::Duplicated, i);
+            row_mask[row] |= bit;
+            column_mask[column] |= bit;
+            block_mask[block_id] |= bit;
+        }
+        return VerifyResult();
+    }
+
+    static VerifyResult verifyLine(const char* line, size_t length, bool require_complete)
+    {
+        uint8_t puzzle[CELLS], grid[CELLS];
+        if(length < 2 * CELLS + 1 ||
+            !(line[CELLS] == ' ' || line[CELLS] == '\t' || line[CELLS] == ',') ||
+            !parseGrid(line, CELLS, puzzle) ||
+            !parseGrid(line + CELLS + 1, length - CELLS - 1, grid))
+        {
+            return VerifyResult(Verdict::Malformed);
+        }
+        return verify(puzzle, grid, require_complete);
+    }
+
+    std::vector<VerifyResult> verifyBatch(const std::string& text, unsigned int threads,
+        bool require_complete)
+    {
+        std::vector<std::pair<const char*, size_t>> lines;
+        const char* begin = text.data();
+        const char* end = begin + text.size();
+        while(begin < end)
+        {
+            const char* eol = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+            if(eol == nullptr)
+                eol = end;
+            size_t length = eol - begin;
+            if(length > 0 && begin[length - 1] == '\r')
+                --length;
+            if(length > 0)
+                lines.push_back(std::make_pair(begin, length));
+            begin = eol + 1;
+        }
+
+        std::vector<VerifyResult> results(lines.size());
+        if(threads == 0)
+            threads = 1;
+        size_t chunk = (lines.size() + threads - 1) / threads;
+        std::vector<std::thread> workers;
+        for(unsigned int t=0; t<threads && t * chunk < lines.size(); ++t)
+        {
+            size_t first = t * chunk, last = std::min(lines.size(), first + chunk);
+            workers.push_back(std::thread([&lines, &results, first, last, require_complete]()
+            {
+                for(size_t i=first; i<last; ++i)
+                    results[i] = verifyLine(lines[i].first, lines[i].second, require_complete);
+            }));
+        }
+        for(auto& worker: workers)
+            worker.join();
+        return results;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef _VERIFIER_H
+#define _VERIFIER_H
+
+#include <string>
+#include <vector>
+#include "Sudoku/Sudoku.h"
+
+namespace Sudoku
+{
+    enum class Verdict {
+        Pass,
+        Malformed,      // line could not be parsed
+        GivenChanged,   // a clue of the puzzle was overwritten
+        Duplicated,     // value already used by the row, column or block
+        Incomplete,     // empty cell while a complete grid is required
+        OutOfRange      // value above 9 in the puzzle or the grid
+    };
+
+    const char* toString(Verdict verdict);
+
+    struct VerifyResult
+    {
+        Verdict verdict;
+        int cell;  // first conflicting cell (row * 9 + column), -1 if none
+
+        VerifyResult(Verdict verdict=Verdict::Pass, int cell=-1):
+            verdict(verdict),
+            cell(cell)
+        {}
+        bool pass(void) const {return verdict == Verdict::Pass;}
+    };
+
+    VerifyResult verify(const uint8_t puzzle[CELLS], const uint8_t grid[CELLS],
+        bool require_complete=true);
+    /*
+     * One "<puzzle> <grid>" pair per line, both as 81 characters ('0' or '.' for empty),
+     * separated by a space, tab or comma. Lines are checked in parallel,
+     * results are returned in line order.
+     */
+    std::vector<VerifyResult> verifyBatch(const std::string& text, unsigned int threads,
+        bool require_complete=true);
+};
+#endif
@@ -1,24 +1,1020 @@
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
 #include "Utilities/Utilities.h"
-#include "Solver/Solver.h"
+#include "Sudoku/Sudoku.h"
+#include "Verifier/Verifier.h"
+#include "Portfolio/Portfolio.h"
+#include "Trace/Trace.h"
+#include "Server/Server.h"
+#include "Enumerator/Enumerator.h"
+#include "Analysis/Analysis.h"
+#include "Shard/Shard.h"
+#include "Telemetry/Telemetry.h"
+#include "Scheduler/Scheduler.h"
 
-int main(int argc, char** argv)
+void usage(const char* prog)
+{
+    std::cerr << "Usage: " << prog << " <problem file> [--max-iters N] [--timeout-ms T]\n";
+    std::cerr << "       " << prog << " --batch <puzzle file> [--output F] [--format pretty|text|binary] [--max-iters N] [--timeout-ms T]\n";
+    std::cerr << "       " << prog << " --batch <puzzle file> --schedule lpt|fifo [--threads N] [--output F] [--format pretty|text|binary]\n";
+    std::cerr << "       " << prog << " --verify <batch file> [--threads N] [--partial]\n";
+    std::cerr << "       " << prog << " <problem file> --enumerate <output|-> [--format text|binary] [--limit N] [--threads N]\n";
+    std::cerr << "       " << prog << " --minimality (<problem file> | --batch <puzzle file>) [--threads N]\n";
+    std::cerr << "       " << prog << " --shard <puzzle file> [--workers N] [--shard-size S]\n";
+    std::cerr << "       " << prog << " --serve <socket path> | --serve-port P [--threads N] [--serve-batch B]\n";
+    std::cerr << "  a problem file may carry K cage lines and an R line of 81 region digits (Jigsaw);\n";
+    std::cerr << "  puzzle files hold standard 81-digit grids only\n";
+    std::cerr << "  --portfolio N    race N differently configured searches per puzzle\n";
+    std::cerr << "  --engine E       propagation (default) or cdcl\n";
+    std::cerr << "  --format F       pretty boards (default), text: 81 digits per line, binary: packed grids\n";
+    std::cerr << "  --status         print the board after every propagation iteration\n";
+    std::cerr << "  --probe N        probe up to N bi-value cells before each guess\n";
+    std::cerr << "  --probe-depth D  propagation rounds per probe (default 4)\n";
+    std::cerr << "  --perf           hardware counters per solve and phase (Linux perf_event_open)\n";
+    std::cerr << "  --schedule O     with --batch, solve on --threads in lpt (predicted hardest first) or fifo order\n";
+    std::cerr << "  --json F         with --batch, write per-puzzle stats as JSON to F\n";
+    std::cerr << "  --trace F        record the search into F, decode with trace_decode;\n"
+        "                   portfolio workers are not traced\n";
+    std::cerr << "  --trace-size N   events kept by the trace ring (default 1048576)\n";
+    std::cerr << "  --telemetry T    batch, shard and server snapshots appended to file T or served on unix:<path>\n";
+    std::cerr << "  --telemetry-ms T time between two snapshots (default 1000)\n";
+    std::cerr << "  --checkpoint F   save progress into F (batch needs --output, enumeration a file and one thread)\n";
+    std::cerr << "  --checkpoint-ms T  minimum time between two saves (default 10000)\n";
+    std::cerr << "  --resume         continue from the --checkpoint file of an interrupted run\n";
+}
+
+bool readFile(const char* filename, std::string& text)
+{
+    std::ifstream f(filename, std::ios::binary);
+    if(!f.is_open())
+    {
+        std::cerr << "Failed to open file: " << filename << "\n";
+        return false;
+    }
+    std::stringstream ss;
+    ss << f.rdbuf();
+    text = ss.str();
+    return true;
+}
+
+int runVerify(const char* filename, unsigned int threads, bool require_complete)
+{
+    std::string text;
+    if(!readFile(filename, text))
+        return -1;
+    auto tic = std::chrono::steady_clock::now();
+    std::vector<Sudoku::VerifyResult> results = Sudoku::verifyBatch(text, threads, require_complete);
+    double elapsed = getTimeDiff(tic);
+
+    size_t passed = 0;
+    std::string out;
+    out.reserve(1 << 20);
+    char line[64];
+    for(size_t i=0; i<results.size(); ++i)
+    {
+        const Sudoku::VerifyResult& result = results[i];
+        int length;
+        if(result.pass())
+        {
+            ++passed;
+            length = std::snprintf(line, sizeof(line), "%zu PASS\n", i);
+        }
+        else if(result.cell < 0)
+            length = std::snprintf(line, sizeof(line), "%zu FAIL %s\n", i, Sudoku::toString(result.verdict));
+        else
+            length = std::snprintf(line, sizeof(line), "%zu FAIL %s (%d, %d)\n", i,
+                Sudoku::toString(result.verdict), result.cell / 9, result.cell % 9);
+        out.append(line, length);
+        if(out.size() >= (1 << 20))
+        {
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            out.clear();
+        }
+    }
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    std::cerr << "Verified " << results.size() << " grids (" << passed << " passed) in "
+        << elapsed << " us";
+    if(elapsed > 0)
+        std::cerr << " (" << results.size() / elapsed * 1e6 << " grids/s)";
+    std::cerr << "\n";
+    return passed == results.size()? 0: 1;
+}
+
+void displayGrid(const uint8_t grid[CELLS])
+{
+    std::array<std::array<int, 9>, 9> matrix;
+    int remains = 0;
+    for(int i=0; i<CELLS; ++i)
+    {
+        matrix[i / 9][i % 9] = grid[i];
+        if(grid[i] == 0)
+            ++remains;
+    }
+    print2DArray<9, 9>(matrix);
+    std::cout << "(" << remains << " remains)\n";
+}
+
+void displayCandidates(const uint16_t candidates[CELLS])
+{
+    for(int i=0; i<CELLS; ++i)
+    {
+        if(candidates[i] == 0)
+            continue;
+        std::cout << Coord(i / 9, i % 9) << ": ";
+        for(int value=1; value<=9; ++value)
+        {
+            if(candidates[i] & (1 << value))
+                std::cout << value << " ";
+        }
+        std::cout << "\n";
+    }
+}
+
+void displayPerf(const Sudoku::Stats& stats)
 {
-    Sudoku::Solver p(argv[1]);
-    p.showStatus();
-    std::cout << "==================\n";
-    auto tic = std::chrono::system_clock::now();
-    p.solve(true);
-    if(p.getSolved())
+    std::cout << "Counters: ";
+    Sudoku::printPerf(std::cout, stats.perf);
+    std::cout << "\n";
+    for(int i=0; i<PHASE_NUM; ++i)
+    {
+        if(!stats.phases[i].any())
+            continue;
+        std::cout << "  " << Sudoku::toString(static_cast<Sudoku::Phase>(i)) << ": ";
+        Sudoku::printPerf(std::cout, stats.phases[i]);
+        std::cout << "\n";
+    }
+}
+
+void writeJson(std::ostream& os, size_t index, Sudoku::Status status, const Sudoku::Stats& stats)
+{
+    os << "  {\"index\": " << index << ", \"status\": \"" << Sudoku::toString(status)
+        << "\", \"iters\": " << stats.iters << ", \"guesses\": " << stats.guesses
+        << ", \"backtraces\": " << stats.backtraces << ", \"elapsed_us\": " << stats.elapsed_us
+        << ", \"perf\": ";
+    Sudoku::writePerfJson(os, stats.perf);
+    os << ", \"phases\": {";
+    for(int i=0; i<PHASE_NUM; ++i)
+    {
+        os << (i == 0? "": ", ") << "\"" << Sudoku::toString(static_cast<Sudoku::Phase>(i)) << "\": ";
+        Sudoku::writePerfJson(os, stats.phases[i]);
+    }
+    os << "}}";
+}
+
+void displayResult(Sudoku::Status status, const uint8_t solution[CELLS], const Sudoku::Stats& stats)
+{
+    switch(status)
+    {
+        case Sudoku::Status::Solved:
+            displayGrid(solution);
+            std::cout << "Solved after " << stats.iters << " iterations";
+            if(stats.guesses != 0)
+            {
+                std::cout << " and " << stats.guesses << " assumptions (";
+                std::cout << stats.backtraces << " backtraces)";
+            }
+            if(stats.probe_eliminations != 0)
+                std::cout << ", " << stats.probe_eliminations << " candidates eliminated by probing,";
+            std::cout << " in " << stats.elapsed_us << " us\n";
+            if(stats.conflicts != 0)
+            {
+                std::cout << stats.conflicts << " conflicts (" << stats.conflicts / stats.elapsed_us * 1e6
+                    << " conflicts/s), " << stats.learned_clauses << " learned clauses, "
+                    << stats.restarts << " restarts\n";
+            }
+            if(stats.perf.any())
+                displayPerf(stats);
+            break;
+
+        case Sudoku::Status::Invalid:
+        case Sudoku::Status::Unsolvable:
+            std::cerr << "The quiz may be problematic, please check! ("
+                << Sudoku::toString(status) << ")\n";
+            break;
+
+        default:
+            std::cout << "Stopped (" << Sudoku::toString(status) << ") after "
+                << stats.iters << " iterations in " << stats.elapsed_us << " us, partial progress:\n";
+            displayGrid(solution);
+            displayCandidates(stats.candidates);
+            break;
+    }
+}
+
+Sudoku::Status solvePuzzle(const uint8_t grid[CELLS], const std::vector<Sudoku::Cage>& cages,
+    const Sudoku::Regions& regions, uint8_t solution[CELLS], const Sudoku::Options& options, Sudoku::Stats& stats,
+    Sudoku::Portfolio* portfolio, bool pretty=true)
+{
+    if(portfolio == nullptr)
+        return Sudoku::solve(grid, cages, regions, solution, options, &stats);
+    int winner;
+    Sudoku::Status status = portfolio->solve(grid, cages, regions, solution, options, &stats, &winner);
+    if(winner >= 0 && pretty)
+        std::cout << "Portfolio winner: [" << winner << "]\n";
+    return status;
+}
+
+// where a batch stopped: input offset of the next puzzle and size of the output (and JSON) written so far
+struct BatchCheckpoint
+{
+    unsigned long long input;
+    unsigned long long output;
+    unsigned long long json;    // 0 without --json
+    size_t index;
+    size_t solved;
+};
+
+bool saveBatchCheckpoint(const char* filename, const BatchCheckpoint& checkpoint)
+{
+    std::string temp = std::string(filename) + ".tmp";
+    {
+        std::ofstream f(temp);
+        f << "SDKB 2\ninput " << checkpoint.input << "\noutput " << checkpoint.output << "\njson "
+            << checkpoint.json << "\nindex "
+            << checkpoint.index << "\nsolved " << checkpoint.solved << "\n";
+        if(!f.flush())
+            return false;
+    }
+    return std::rename(temp.c_str(), filename) == 0;
+}
+
+bool loadBatchCheckpoint(const char* filename, BatchCheckpoint& checkpoint)
+{
+    std::ifstream f(filename);
+    std::string magic, key;
+    int version;
+    return (f >> magic >> version) && magic == "SDKB" && version == 2 &&
+        (f >> key >> checkpoint.input >> key >> checkpoint.output >> key >> checkpoint.json >> key >> checkpoint.index
+            >> key >> checkpoint.solved);
+}
+
+// pretty: boards and stats on stdout, otherwise one solution (partial if unsolved) per puzzle
+// in format, with the summary on stderr
+int runBatch(const char* filename, Sudoku::Options options, Sudoku::Portfolio* portfolio,
+    const char* json_file, const char* output_file, const char* checkpoint_file,
+    bool pretty, Sudoku::Format format, Sudoku::Telemetry* telemetry)
+{
+    std::string text;
+    if(!readFile(filename, text))
+        return -1;
+    BatchCheckpoint checkpoint{0, 0, 0, 0, 0};
+    std::string state_file;
+    if(checkpoint_file != nullptr)
+    {
+        if(output_file == nullptr)
+        {
+            std::cerr << "Checkpointing a batch needs --output\n";
+            return -1;
+        }
+        // the in-flight puzzle keeps its search state next to the batch progress
+        state_file = std::string(checkpoint_file) + ".state";
+        options.state_file = state_file.c_str();
+        if(options.resume && !loadBatchCheckpoint(checkpoint_file, checkpoint))
+        {
+            std::cerr << "No checkpoint to resume in " << checkpoint_file << ", starting over\n";
+            options.resume = false;
+        }
+        if(checkpoint.input > text.size())
+        {
+            std::cerr << "Checkpoint does not match " << filename << "\n";
+            return -1;
+        }
+        if(json_file != nullptr && checkpoint.index != 0 && checkpoint.json == 0)
+        {
+            std::cerr << "Checkpoint was taken without --json\n";
+            return -1;
+        }
+    }
+    // drop whatever was written after the checkpoint
+    if(output_file != nullptr && checkpoint.output != 0 && truncate(output_file, checkpoint.output) != 0)
+    {
+        std::cerr << "Failed to truncate file: " << output_file << "\n";
+        return -1;
+    }
+    std::fstream out;
+    std::streambuf* console = nullptr;
+    FILE* file = nullptr;
+    std::unique_ptr<Sudoku::SolutionWriter> writer;
+    std::unique_ptr<Sudoku::SolutionBuffer> buffer;
+    if(!pretty)
+    {
+        file = output_file == nullptr? stdout: std::fopen(output_file, checkpoint.output != 0? "ab": "wb");
+        if(file == nullptr)
+        {
+            std::cerr << "Failed to open file: " << output_file << "\n";
+            return -1;
+        }
+        writer.reset(new Sudoku::SolutionWriter(file, format, checkpoint.output));
+        buffer.reset(new Sudoku::SolutionBuffer(writer.get()));
+    }
+    else if(output_file != nullptr)
     {
-        p.display();
-        std::cout << "Solved after " << p.getIter() << " iterations";
-        if(p.getGuessNum() != 0)
+        out.open(output_file, std::ios::in | std::ios::out | std::ios::binary |
+            (checkpoint.output != 0? std::ios::openmode(): std::ios::trunc));
+        if(!out.is_open())
+        {
+            std::cerr << "Failed to open file: " << output_file << "\n";
+            return -1;
+        }
+        out.seekp(0, std::ios::end);
+        console = std::cout.rdbuf(out.rdbuf());
+    }
+    std::fstream json;
+    if(json_file != nullptr)
+    {
+        if(checkpoint.json != 0 && truncate(json_file, checkpoint.json) != 0)
+        {
+            std::cerr << "Failed to truncate file: " << json_file << "\n";
+            return -1;
+        }
+        json.open(json_file, std::ios::in | std::ios::out | std::ios::binary |
+            (checkpoint.json != 0? std::ios::openmode(): std::ios::trunc));
+        if(!json.is_open())
+        {
+            std::cerr << "Failed to open file: " << json_file << "\n";
+            return -1;
+        }
+        json.seekp(0, std::ios::end);
+        if(checkpoint.json == 0)
+            json << "[\n";
+    }
+    std::stringstream ss(text);
+    ss.seekg(checkpoint.input);
+    std::string line;
+    size_t index = checkpoint.index, solved = checkpoint.solved;
+    // "[\n" alone means nothing was recorded before the checkpoint
+    bool first_record = checkpoint.json <= 2;
+    auto tic = std::chrono::steady_clock::now();
+    auto next_checkpoint = tic + std::chrono::microseconds(options.checkpoint_interval_us);
+    while(std::getline(ss, line))
+    {
+        if(line.empty() || line == "\r")
+            continue;
+        uint8_t grid[CELLS], solution[CELLS];
+        if(pretty)
+            std::cout << "Puzzle " << index << ":\n";
+        ++index;
+        if(!Sudoku::parseGrid(line.data(), line.size(), grid))
+        {
+            std::cerr << "Invalid puzzle: " << line << "\n";
+            if(!pretty)
+            {
+                // keeps the output aligned with the input
+                std::fill(solution, solution + CELLS, 0);
+                buffer->append(solution);
+            }
+            continue;
+        }
+        Sudoku::Stats stats;
+        Sudoku::Status status = solvePuzzle(grid, std::vector<Sudoku::Cage>(), Sudoku::Regions(), solution, options, stats,
+            portfolio, pretty);
+        if(pretty)
+            displayResult(status, solution, stats);
+        else
+            buffer->append(solution);
+        if(telemetry != nullptr)
+            telemetry->record(index - 1, status, stats.elapsed_us, stats.guesses, stats.backtraces);
+        if(json.is_open())
         {
-            std::cout << "and " << p.getGuessNum() << " assumptions (";
-            std::cout << p.getBacktraceNum() << " backtraces)";
+            json << (first_record? "": ",\n");
+            writeJson(json, index - 1, status, stats);
+            first_record = false;
         }
-        std::cout << " in " << getTimeDiff(tic) << " us\n";
+        if(status == Sudoku::Status::Solved)
+            ++solved;
+        // only the first puzzle after a resume can have a saved search
+        options.resume = false;
+        if(checkpoint_file != nullptr && std::chrono::steady_clock::now() >= next_checkpoint)
+        {
+            unsigned long long position;
+            if(pretty)
+            {
+                std::cout.flush();
+                position = out.tellp();
+            }
+            else
+            {
+                buffer->flush();
+                position = writer->sync();
+            }
+            unsigned long long json_position = 0;
+            if(json.is_open())
+            {
+                json.flush();
+                json_position = json.tellp();
+            }
+            checkpoint = {static_cast<unsigned long long>(ss.eof()? text.size(): static_cast<size_t>(ss.tellg())),
+                position, json_position, index, solved};
+            if(!saveBatchCheckpoint(checkpoint_file, checkpoint))
+                std::cerr << "Failed to write checkpoint: " << checkpoint_file << "\n";
+            next_checkpoint = std::chrono::steady_clock::now() + std::chrono::microseconds(options.checkpoint_interval_us);
+        }
+    }
+    if(json.is_open())
+        json << "\n]\n";
+    bool failed = false;
+    if(!pretty)
+    {
+        buffer.reset();
+        failed = writer->getError() || (file != stdout? std::fclose(file) != 0: std::fflush(file) != 0);
+    }
+    std::ostream& report = pretty? std::cout: std::cerr;
+    report << "Solved " << solved << "/" << index << " puzzles in " << getTimeDiff(tic) << " us\n";
+    if(portfolio != nullptr)
+        portfolio->report(report);
+    if(console != nullptr)
+        std::cout.rdbuf(console);
+    if(failed)
+    {
+        std::cerr << "Failed to write " << (output_file != nullptr? output_file: "stdout") << "\n";
+        return -1;
+    }
+    if(checkpoint_file != nullptr)
+    {
+        std::remove(checkpoint_file);
+        std::remove(state_file.c_str());
+    }
+    return solved == index? 0: 1;
+}
+
+Sudoku::Server* g_server = nullptr;
+
+void stopServer(int)
+{
+    if(g_server != nullptr)
+        g_server->stop();
+}
+
+int runServer(const Sudoku::ServerConfig& config)
+{
+    try
+    {
+        Sudoku::Server server(config);
+        g_server = &server;
+        std::signal(SIGINT, stopServer);
+        std::signal(SIGTERM, stopServer);
+        std::signal(SIGPIPE, SIG_IGN);
+        std::cerr << "Serving on " << (config.socket_path.empty()? "127.0.0.1:" + std::to_string(config.port):
+            config.socket_path) << " with " << config.threads << " workers\n";
+        server.run();
+        g_server = nullptr;
+        std::cerr << "Served " << server.getServedNum() << " requests\n";
+    }
+    catch(const std::exception& e)
+    {
+        g_server = nullptr;
+        std::cerr << e.what() << "\n";
+        return -1;
     }
-    p.displayGuessHistory();
     return 0;
-}
\ No newline at end of file
+}
+
+int runEnumerate(const char* filename, const char* output, Sudoku::Format format,
+    const Sudoku::Options& options, unsigned int threads, unsigned long long limit)
+{
+    uint8_t grid[CELLS];
+    std::vector<Sudoku::Cage> cages;
+    Sudoku::Regions regions;
+    try
+    {
+        Sudoku::loadProblem(filename, grid, &cages, &regions);
+        if(!cages.empty())
+            throw std::runtime_error("Enumeration does not support cages");
+        if(!regions.isStandard())
+            throw std::runtime_error("Enumeration does not support irregular regions");
+        Sudoku::Enumerator enumerator(grid);
+        bool resumed = false;
+        if(options.state_file != nullptr)
+        {
+            if(std::strcmp(output, "-") == 0)
+                throw std::runtime_error("Checkpointing an enumeration needs an output file");
+            if(options.resume && !(resumed = enumerator.resume(options.state_file)))
+                std::cerr << "No checkpoint to resume in " << options.state_file << ", starting over\n";
+            // solutions written after the checkpoint are found again
+            if(resumed && truncate(output, enumerator.getResumeOutput()) != 0)
+                throw std::runtime_error(std::string("Failed to truncate file: ") + output);
+        }
+        FILE* f = std::strcmp(output, "-") == 0? stdout: std::fopen(output, resumed? "ab": "wb");
+        if(f == nullptr)
+            throw std::runtime_error(std::string("Failed to open file: ") + output);
+        Sudoku::SolutionWriter writer(f, format, resumed? enumerator.getResumeOutput(): 0);
+        auto tic = std::chrono::steady_clock::now();
+        unsigned long long count = enumerator.run(&writer, options, threads, limit);
+        double elapsed = getTimeDiff(tic);
+        bool failed = writer.getError() || (f != stdout? std::fclose(f) != 0: std::fflush(f) != 0);
+        std::cerr << count << " solutions (" << Sudoku::toString(enumerator.getStatus()) << ") in "
+            << elapsed << " us";
+        if(elapsed > 0)
+            std::cerr << " (" << count / elapsed * 1e6 << " solutions/s)";
+        std::cerr << "\n";
+        if(failed)
+            throw std::runtime_error(std::string("Failed to write ") + output);
+        if(options.state_file != nullptr && enumerator.getStatus() == Sudoku::Status::Solved)
+            std::remove(options.state_file);
+        return enumerator.getStatus() == Sudoku::Status::Solved? 0: 1;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        return -1;
+    }
+}
+
+bool readPuzzles(const char* filename, std::vector<Sudoku::Grid>& puzzles)
+{
+    std::string text;
+    if(!readFile(filename, text))
+        return false;
+    std::stringstream ss(text);
+    std::string line;
+    while(std::getline(ss, line))
+    {
+        if(line.empty() || line == "\r")
+            continue;
+        Sudoku::Grid grid;
+        if(!Sudoku::parseGrid(line.data(), line.size(), grid.data()))
+        {
+            std::cerr << "Invalid puzzle: " << line << "\n";
+            return false;
+        }
+        puzzles.push_back(grid);
+    }
+    return true;
+}
+
+int runMinimality(const char* filename, const char* batch_file, unsigned int threads)
+{
+    std::vector<Sudoku::Grid> puzzles;
+    if(batch_file != nullptr)
+    {
+        if(!readPuzzles(batch_file, puzzles))
+            return -1;
+    }
+    else
+    {
+        Sudoku::Grid grid;
+        std::vector<Sudoku::Cage> cages;
+        Sudoku::Regions regions;
+        try
+        {
+            Sudoku::loadProblem(filename, grid.data(), &cages, &regions);
+            if(!cages.empty())
+                throw std::runtime_error("Minimality analysis does not support cages");
+            if(!regions.isStandard())
+                throw std::runtime_error("Minimality analysis does not support irregular regions");
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << e.what() << "\n";
+            return -1;
+        }
+        puzzles.push_back(grid);
+    }
+    auto tic = std::chrono::steady_clock::now();
+    std::vector<Sudoku::Minimality> results = Sudoku::analyzeMinimality(puzzles, threads);
+    double elapsed = getTimeDiff(tic);
+    size_t minimal = 0;
+    for(size_t i=0; i<results.size(); ++i)
+    {
+        const Sudoku::Minimality& result = results[i];
+        std::cout << "Puzzle " << i << ": " << result.clues.size() << " clues, ";
+        if(result.solutions != 1)
+        {
+            std::cout << (result.solutions == 0? "no solution": "multiple solutions") << "\n";
+            continue;
+        }
+        if(result.minimal())
+        {
+            ++minimal;
+            std::cout << "minimal\n";
+            continue;
+        }
+        std::cout << result.redundant.size() << " redundant:";
+        for(auto cell: result.redundant)
+            std::cout << " " << Coord(cell / 9, cell % 9) << "=" << static_cast<int>(puzzles[i][cell]);
+        std::cout << "\n";
+    }
+    std::cout << minimal << "/" << results.size() << " puzzles minimal, analyzed in " << elapsed << " us\n";
+    return 0;
+}
+
+// parallel batch, output in input order as with runBatch
+int runScheduled(const char* filename, const Sudoku::Options& options, unsigned int threads, Sudoku::Order order,
+    const char* json_file, const char* output_file, bool pretty, Sudoku::Format format, Sudoku::Telemetry* telemetry)
+{
+    std::vector<Sudoku::Grid> puzzles;
+    if(!readPuzzles(filename, puzzles))
+        return -1;
+    std::ofstream json;
+    if(json_file != nullptr)
+    {
+        json.open(json_file);
+        if(!json.is_open())
+        {
+            std::cerr << "Failed to open file: " << json_file << "\n";
+            return -1;
+        }
+        json << "[\n";
+    }
+    std::fstream out;
+    std::streambuf* console = nullptr;
+    FILE* file = nullptr;
+    std::unique_ptr<Sudoku::SolutionWriter> writer;
+    std::unique_ptr<Sudoku::SolutionBuffer> buffer;
+    if(!pretty)
+    {
+        file = output_file == nullptr? stdout: std::fopen(output_file, "wb");
+        if(file == nullptr)
+        {
+            std::cerr << "Failed to open file: " << output_file << "\n";
+            return -1;
+        }
+        writer.reset(new Sudoku::SolutionWriter(file, format));
+        buffer.reset(new Sudoku::SolutionBuffer(writer.get()));
+    }
+    else if(output_file != nullptr)
+    {
+        out.open(output_file, std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!out.is_open())
+        {
+            std::cerr << "Failed to open file: " << output_file << "\n";
+            return -1;
+        }
+        console = std::cout.rdbuf(out.rdbuf());
+    }
+    Sudoku::Scheduler scheduler(threads, order);
+    std::vector<Sudoku::BatchResult> results;
+    size_t solved = 0;
+    auto tic = std::chrono::steady_clock::now();
+    scheduler.run(puzzles, options, results, [&](size_t i)
+    {
+        Sudoku::BatchResult& result = results[i];
+        if(pretty)
+        {
+            std::cout << "Puzzle " << i << ":\n";
+            displayResult(result.status, result.solution, result.stats);
+        }
+        else
+            buffer->append(result.solution);
+        if(json.is_open())
+        {
+            json << (i == 0? "": ",\n");
+            writeJson(json, i, result.status, result.stats);
+        }
+        if(telemetry != nullptr)
+            telemetry->record(i, result.status, result.stats.elapsed_us, result.stats.guesses, result.stats.backtraces);
+        if(result.status == Sudoku::Status::Solved)
+            ++solved;
+    });
+    if(json.is_open())
+        json << "\n]\n";
+    bool failed = false;
+    if(!pretty)
+    {
+        buffer.reset();
+        failed = writer->getError() || (file != stdout? std::fclose(file) != 0: std::fflush(file) != 0);
+    }
+    std::ostream& report = pretty? std::cout: std::cerr;
+    report << "Solved " << solved << "/" << puzzles.size() << " puzzles in " << getTimeDiff(tic) << " us\n";
+    scheduler.report(report);
+    if(console != nullptr)
+        std::cout.rdbuf(console);
+    if(failed)
+    {
+        std::cerr << "Failed to write " << (output_file != nullptr? output_file: "stdout") << "\n";
+        return -1;
+    }
+    return solved == puzzles.size()? 0: 1;
+}
+
+int runShard(const char* filename, const Sudoku::ShardConfig& config, Sudoku::Telemetry* telemetry)
+{
+    std::vector<Sudoku::Grid> puzzles;
+    if(!readPuzzles(filename, puzzles))
+        return -1;
+    std::vector<Sudoku::Response> results;
+    std::string out;
+    out.reserve(1 << 20);
+    bool complete;
+    try
+    {
+        Sudoku::Coordinator coordinator(config);
+        // merged in input order while later shards are still running
+        complete = coordinator.run(puzzles, results, [&](size_t i)
+        {
+            char line[128];
+            if(telemetry != nullptr)
+            {
+                telemetry->record(i, results[i].status, results[i].elapsed_us, results[i].guesses,
+                    results[i].backtraces);
+            }
+            int length = std::snprintf(line, sizeof(line), "%zu %s ", i, Sudoku::toString(results[i].status));
+            out.append(line, length);
+            for(int cell=0; cell<CELLS; ++cell)
+                out.push_back('0' + results[i].solution[cell]);
+            out.push_back('\n');
+            if(out.size() >= (1 << 20))
+            {
+                std::fwrite(out.data(), 1, out.size(), stdout);
+                out.clear();
+            }
+        });
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        std::fflush(stdout);
+        coordinator.report(std::cerr);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        return -1;
+    }
+    return complete? 0: 1;
+}
+
+int runSingle(const char* filename, const Sudoku::Options& options, Sudoku::Portfolio* portfolio,
+    bool pretty, Sudoku::Format format)
+{
+    uint8_t grid[CELLS], solution[CELLS];
+    std::vector<Sudoku::Cage> cages;
+    Sudoku::Regions regions;
+    try
+    {
+        Sudoku::loadProblem(filename, grid, &cages, &regions);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        return -1;
+    }
+    if(pretty)
+    {
+        displayGrid(grid);
+        std::cout << "==================\n";
+    }
+    Sudoku::Stats stats;
+    Sudoku::Status status = solvePuzzle(grid, cages, regions, solution, options, stats, portfolio, pretty);
+    if(options.resume && options.state_file != nullptr && !stats.resumed)
+        std::cerr << "No checkpoint to resume in " << options.state_file << ", started over\n";
+    if(pretty)
+    {
+        displayResult(status, solution, stats);
+        if(portfolio != nullptr)
+            portfolio->report(std::cout);
+    }
+    else
+    {
+        Sudoku::SolutionWriter writer(stdout, format);
+        Sudoku::SolutionBuffer(&writer).append(solution);
+        if(status != Sudoku::Status::Solved)
+            std::cerr << Sudoku::toString(status) << "\n";
+    }
+    switch(status)
+    {
+        case Sudoku::Status::Solved:
+            return 0;
+        case Sudoku::Status::Invalid:
+        case Sudoku::Status::Unsolvable:
+            return -1;
+        default:
+            return 1;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* filename = nullptr;
+    const char* verify_file = nullptr;
+    const char* batch_file = nullptr;
+    unsigned int portfolio_size = 0;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool require_complete = true;
+    const char* trace_file = nullptr;
+    Sudoku::ServerConfig server_config;
+    bool serve = false;
+    const char* enumerate_file = nullptr;
+    Sudoku::Format format = Sudoku::Format::Text;
+    bool pretty = true;
+    unsigned long long limit = 0;
+    bool minimality = false;
+    const char* json_file = nullptr;
+    const char* shard_file = nullptr;
+    bool shard_worker = false;
+    Sudoku::ShardConfig shard_config;
+    size_t trace_size = 1 << 20;
+    const char* output_file = nullptr;
+    const char* checkpoint_file = nullptr;
+    const char* telemetry_target = nullptr;
+    bool scheduled = false;
+    Sudoku::Order order = Sudoku::Order::Lpt;
+    long long telemetry_interval_us = 1000000;
+    Sudoku::Options options;
+    for(int i=1; i<argc; ++i)
+    {
+        if(std::strcmp(argv[i], "--verify") == 0 && i + 1 < argc)
+            verify_file = argv[++i];
+        else if(std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+            batch_file = argv[++i];
+        else if(std::strcmp(argv[i], "--portfolio") == 0 && i + 1 < argc)
+            portfolio_size = std::atoi(argv[++i]);
+        else if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = std::atoi(argv[++i]);
+        else if(std::strcmp(argv[i], "--partial") == 0)
+            require_complete = false;
+        else if(std::strcmp(argv[i], "--engine") == 0 && i + 1 < argc)
+        {
+            const char* engine = argv[++i];
+            if(std::strcmp(engine, "cdcl") == 0)
+                options.engine = Sudoku::Engine::Cdcl;
+            else if(std::strcmp(engine, "propagation") == 0)
+                options.engine = Sudoku::Engine::Propagation;
+            else
+            {
+                usage(argv[0]);
+                return -1;
+            }
+        }
+        else if(std::strcmp(argv[i], "--probe") == 0 && i + 1 < argc)
+            options.probe_budget = std::atoi(argv[++i]);
+        else if(std::strcmp(argv[i], "--probe-depth") == 0 && i + 1 < argc)
+            options.probe_depth = std::atoi(argv[++i]);
+        else if(std::strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+        {
+            server_config.socket_path = argv[++i];
+            serve = true;
+        }
+        else if(std::strcmp(argv[i], "--serve-port") == 0 && i + 1 < argc)
+        {
+            server_config.port = std::atoi(argv[++i]);
+            serve = true;
+        }
+        else if(std::strcmp(argv[i], "--serve-batch") == 0 && i + 1 < argc)
+            server_config.batch_size = std::atoi(argv[++i]);
+        else if(std::strcmp(argv[i], "--enumerate") == 0 && i + 1 < argc)
+            enumerate_file = argv[++i];
+        else if(std::strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            pretty = std::strcmp(name, "pretty") == 0;
+            if(std::strcmp(name, "binary") == 0)
+                format = Sudoku::Format::Binary;
+            else if(std::strcmp(name, "text") == 0 || pretty)
+                format = Sudoku::Format::Text;
+            else
+            {
+                usage(argv[0]);
+                return -1;
+            }
+        }
+        else if(std::strcmp(argv[i], "--shard") == 0 && i + 1 < argc)
+            shard_file = argv[++i];
+        else if(std::strcmp(argv[i], "--shard-worker") == 0)
+            shard_worker = true;
+        else if(std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+            shard_config.workers = std::atoi(argv[++i]);
+        else if(std::strcmp(argv[i], "--shard-size") == 0 && i + 1 < argc)
+            shard_config.shard_size = std::atoi(argv[++i]);
+        else if(std::strcmp(argv[i], "--status") == 0)
+            options.show_status = true;
+        else if(std::strcmp(argv[i], "--perf") == 0)
+            options.perf_counters = true;
+        else if(std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            json_file = argv[++i];
+        else if(std::strcmp(argv[i], "--minimality") == 0)
+            minimality = true;
+        else if(std::strcmp(argv[i], "--limit") == 0 && i + 1 < argc)
+            limit = std::atoll(argv[++i]);
+        else if(std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            trace_file = argv[++i];
+        else if(std::strcmp(argv[i], "--trace-size") == 0 && i + 1 < argc)
+            trace_size = std::atoll(argv[++i]);
+        else if(std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            output_file = argv[++i];
+        else if(std::strcmp(argv[i], "--schedule") == 0 && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            scheduled = true;
+            if(std::strcmp(name, "lpt") == 0)
+                order = Sudoku::Order::Lpt;
+            else if(std::strcmp(name, "fifo") == 0)
+                order = Sudoku::Order::Fifo;
+            else
+            {
+                usage(argv[0]);
+                return -1;
+            }
+        }
+        else if(std::strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc)
+            telemetry_target = argv[++i];
+        else if(std::strcmp(argv[i], "--telemetry-ms") == 0 && i + 1 < argc)
+            telemetry_interval_us = std::atoll(argv[++i]) * 1000;
+        else if(std::strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc)
+            checkpoint_file = argv[++i];
+        else if(std::strcmp(argv[i], "--checkpoint-ms") == 0 && i + 1 < argc)
+            options.checkpoint_interval_us = std::atoll(argv[++i]) * 1000;
+        else if(std::strcmp(argv[i], "--resume") == 0)
+            options.resume = true;
+        else if(std::strcmp(argv[i], "--max-iters") == 0 && i + 1 < argc)
+            options.max_iters = std::atoi(argv[++i]);
+        else if(std::strcmp(argv[i], "--timeout-ms") == 0 && i + 1 < argc)
+            options.time_limit_us = std::atoll(argv[++i]) * 1000;
+        else if(filename == nullptr)
+            filename = argv[i];
+        else
+        {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if(verify_file != nullptr)
+        return runVerify(verify_file, threads, require_complete);
+    if(shard_worker)
+        return Sudoku::runShardWorker(0, 1, options);
+    std::unique_ptr<Sudoku::Telemetry> telemetry;
+    if(telemetry_target != nullptr)
+    {
+        try
+        {
+            telemetry.reset(new Sudoku::Telemetry(telemetry_target, telemetry_interval_us));
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << e.what() << "\n";
+            return -1;
+        }
+    }
+    if(shard_file != nullptr)
+    {
+        // workers are this program again, with the search settings passed on
+        shard_config.command = {"/proc/self/exe", "--shard-worker",
+            "--engine", Sudoku::toString(options.engine),
+            "--probe", std::to_string(options.probe_budget),
+            "--probe-depth", std::to_string(options.probe_depth),
+            "--max-iters", std::to_string(options.max_iters),
+            "--timeout-ms", std::to_string(options.time_limit_us / 1000)};
+        return runShard(shard_file, shard_config, telemetry.get());
+    }
+    if(minimality && (filename != nullptr || batch_file != nullptr))
+        return runMinimality(filename, batch_file, threads);
+    if(enumerate_file != nullptr && filename != nullptr)
+    {
+        options.state_file = checkpoint_file;
+        return runEnumerate(filename, enumerate_file, format, options, threads, limit);
+    }
+    if(serve)
+    {
+        server_config.threads = threads;
+        server_config.options = options;
+        server_config.telemetry = telemetry.get();
+        return runServer(server_config);
+    }
+    // the pool already uses every thread, and results arrive out of order
+    if(scheduled && (batch_file == nullptr || portfolio_size > 0 || checkpoint_file != nullptr))
+    {
+        usage(argv[0]);
+        return -1;
+    }
+    std::unique_ptr<Sudoku::Portfolio> portfolio;
+    if(portfolio_size > 0)
+        portfolio.reset(new Sudoku::Portfolio(Sudoku::Portfolio::defaultConfigs(portfolio_size)));
+    if(batch_file == nullptr && filename == nullptr)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+    // portfolio workers record nothing, only searches run on this thread are traced
+    if(options.perf_counters && !Sudoku::PerfCounters::thread().available())
+        std::cerr << "Hardware counters unavailable, --perf reports nothing\n";
+    if(trace_file != nullptr)
+        Sudoku::startTrace(trace_size);
+    int ret;
+    if(batch_file != nullptr && scheduled)
+        ret = runScheduled(batch_file, options, threads, order, json_file, output_file, pretty, format,
+            telemetry.get());
+    else if(batch_file != nullptr)
+        ret = runBatch(batch_file, options, portfolio.get(), json_file, output_file, checkpoint_file,
+            pretty, format, telemetry.get());
+    else
+    {
+        options.state_file = checkpoint_file;
+        ret = runSingle(filename, options, portfolio.get(), pretty, format);
+        // a stopped search keeps its state for --resume
+        if(checkpoint_file != nullptr && ret != 1)
+            std::remove(checkpoint_file);
+    }
+    if(trace_file != nullptr)
+    {
+        if(!Sudoku::t_trace->dump(trace_file))
+            std::cerr << "Failed to write trace: " << trace_file << "\n";
+        Sudoku::stopTrace();
+    }
+    return ret;
+}